@@ -0,0 +1,387 @@
+#ifndef COM_MASAERS_BACKJUMP_HPP
+#define COM_MASAERS_BACKJUMP_HPP
+#include "sudoku.hpp"
+#include "branching.hpp"
+#include <deque>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace com_masaers {
+  /**
+     Depth first search with conflict-directed backjumping and nogood
+     learning.
+
+     Every cell carries a reason: the set of decisions (identified by
+     the position they solved) that its eliminations follow from. When
+     a cell runs out of values, its reason is the conflict. Search then
+     backjumps straight to the deepest decision in the conflict,
+     skipping every decision in between, since the conflict holds
+     whatever they chose. When every alternative of a decision has
+     failed, the union of their conflicts (less the decision itself,
+     plus the reason why the alternatives were all there was) is
+     learned as a nogood: a set of placements that can never hold
+     together. Nogoods are checked whenever a cell is solved, for the
+     rest of the search. Once a solution has been found, search goes
+     on by plain backtracking, and learns nothing more.
+
+     Reasons are only tracked through naked single propagation, so
+     there is no Propagation policy. Branching policies are used as by
+     depth_first_solver, and the alternatives of hidden_candidate_branching
+     and of the cell based policies are explained precisely.
+
+     Has the same interface as depth_first_solver.
+   */
+  template<typename Layout, typename Branching = hidden_candidate_branching>
+  class backjumping_solver {
+  public:
+    typedef typename Layout::cell_type cell_type;
+    typedef typename Layout::position_set position_set;
+    const sudoku_board<Layout>& operator()(const sudoku_board<Layout>& board);
+    const std::vector<sudoku_board<Layout> >& operator()(const sudoku_board<Layout>& board, std::size_t solutions);
+    // Alternatives skipped by backjumping in the last search.
+    std::size_t skipped() const { return skipped_m; }
+    // Nogoods learned, and branches cut by them, in the last search.
+    std::size_t learned() const { return learned_m; }
+    std::size_t cut() const { return cut_m; }
+    // The number of nodes entered by the last search.
+    std::size_t nodes() const { return nodes_m; }
+  protected:
+    // The longest nogood worth keeping, and the most nogoods kept.
+    static constexpr int MAX_NOGOOD_SIZE = 8;
+    static constexpr std::size_t MAX_NOGOODS = 1 << 14;
+    struct frame_type {
+      std::pair<int, int> alternatives[Layout::N];
+      int next;
+      int last;
+      std::size_t mark;
+      // The position solved by the alternative being tried, or -1.
+      int decision;
+      // Why the alternatives that failed so far failed, and why there
+      // were no other alternatives.
+      position_set conflict;
+    }; // frame_type
+    // Records cells and their reasons before they change.
+    class reason_trail {
+    public:
+      struct entry_type {
+        int pos;
+        cell_type cell;
+        position_set reason;
+      };
+      std::size_t size() const { return entries_m.size(); }
+      // Empties the trail, and starts recording the given reasons.
+      void clear(std::vector<position_set>& reasons) { reasons_m = &reasons; entries_m.clear(); }
+      void record(const int pos, const cell_type& cell) { entries_m.push_back(entry_type{ pos, cell, (*reasons_m)[pos] }); }
+      void undo(sudoku_board<Layout>& board, const std::size_t mark);
+    private:
+      std::vector<position_set>* reasons_m = nullptr;
+      std::vector<entry_type> entries_m;
+    }; // reason_trail
+    void search(const sudoku_board<Layout>& board, std::size_t solutions);
+    bool decide(const int pos, const int value);
+    bool propagate();
+    bool check_nogoods(const int pos);
+    void learn(const position_set& conflict);
+    position_set explain(const frame_type& frame) const;
+    position_set explain_unit(const int unit, const int value, const frame_type& frame) const;
+    position_set decisions() const;
+  private:
+    sudoku_board<Layout> board_m;
+    std::vector<position_set> reasons_m = std::vector<position_set>(Layout::NN);
+    reason_trail trail_m;
+    std::vector<frame_type> frames_m;
+    std::deque<int> agenda_m;
+    position_set conflict_m;
+    // Nogoods are stored back to back as a length followed by that
+    // many (pos * N + value) placements, and watched by each of their
+    // placements.
+    std::vector<int> nogoods_m;
+    std::vector<std::vector<std::size_t> > watches_m = std::vector<std::vector<std::size_t> >(Layout::N * Layout::NN);
+    std::vector<sudoku_board<Layout> > solutions_m;
+    std::size_t skipped_m = 0;
+    std::size_t learned_m = 0;
+    std::size_t cut_m = 0;
+    std::size_t nodes_m = 0;
+  }; // backjumping_solver
+} // namespace com_masaers
+
+
+template<typename Layout, typename Branching>
+inline void com_masaers::backjumping_solver<Layout, Branching>::reason_trail::undo(sudoku_board<Layout>& board, const std::size_t mark) {
+  while (entries_m.size() > mark) {
+    const entry_type& entry = entries_m.back();
+    board.restore(entry.pos, entry.cell);
+    (*reasons_m)[entry.pos] = entry.reason;
+    entries_m.pop_back();
+  }
+}
+
+template<typename Layout, typename Branching>
+inline const com_masaers::sudoku_board<Layout>& com_masaers::backjumping_solver<Layout, Branching>::operator()(const sudoku_board<Layout>& board) {
+  operator()(board, 1);
+  if (solutions_m.empty()) {
+    return board;
+  } else {
+    return solutions_m.front();
+  }
+}
+
+template<typename Layout, typename Branching>
+const std::vector<com_masaers::sudoku_board<Layout> >& com_masaers::backjumping_solver<Layout, Branching>::operator()(const sudoku_board<Layout>& board, std::size_t solutions) {
+  solutions_m.clear();
+  if (solutions != 0) {
+    search(board, solutions);
+  }
+  return solutions_m;
+}
+
+template<typename Layout, typename Branching>
+void com_masaers::backjumping_solver<Layout, Branching>::search(const sudoku_board<Layout>& board, std::size_t solutions) {
+  board_m = board;
+  trail_m.clear(reasons_m);
+  frames_m.clear();
+  agenda_m.clear();
+  for (auto it = reasons_m.begin(); it != reasons_m.end(); ++it) {
+    it->reset();
+  }
+  for (auto it = watches_m.begin(); it != watches_m.end(); ++it) {
+    it->clear();
+  }
+  nogoods_m.clear();
+  skipped_m = learned_m = cut_m = nodes_m = 0;
+  for (int pos = 0; pos < Layout::NN; ++pos) {
+    if (board_m.solved(pos)) {
+      agenda_m.push_back(pos);
+    } else if (board_m[pos].none()) {
+      return;
+    }
+  }
+  bool consistent = propagate();
+  while (consistent || ! frames_m.empty()) {
+    ++nodes_m;
+    position_set conflict;
+    bool failed = ! consistent;
+    if (! consistent) {
+      conflict = conflict_m;
+    } else if (board_m.solved()) {
+      solutions_m.emplace_back(board_m);
+      if (solutions_m.size() >= solutions) {
+        break;
+      }
+      // Look for more solutions by plain backtracking.
+      conflict = decisions();
+      failed = true;
+    } else {
+      frames_m.emplace_back();
+      frame_type& frame = frames_m.back();
+      frame.next = 0;
+      frame.last = Branching::select(board_m, frame.alternatives) - frame.alternatives;
+      frame.mark = trail_m.size();
+      frame.decision = -1;
+      frame.conflict = explain(frame);
+      if (frame.last == 0) {
+        conflict = frame.conflict;
+        frames_m.pop_back();
+        failed = true;
+      }
+    }
+    if (failed) {
+      // Jump back to the deepest decision that the conflict depends on.
+      // A frame whose alternatives are all used up fails in turn, with
+      // the conflicts of all of its alternatives as its conflict.
+      while (! frames_m.empty()) {
+        frame_type& frame = frames_m.back();
+        if (conflict[frame.decision]) {
+          conflict.reset(frame.decision);
+          frame.conflict |= conflict;
+          if (frame.next != frame.last) {
+            break;
+          }
+          conflict = frame.conflict;
+          if (solutions_m.empty()) {
+            learn(conflict);
+          }
+        } else {
+          skipped_m += frame.last - frame.next;
+        }
+        frames_m.pop_back();
+      }
+      if (frames_m.empty()) {
+        break;
+      }
+    }
+    frame_type& frame = frames_m.back();
+    trail_m.undo(board_m, frame.mark);
+    const std::pair<int, int>& alternative = frame.alternatives[frame.next++];
+    frame.decision = alternative.first;
+    consistent = decide(alternative.first, alternative.second);
+  }
+}
+
+// Places value at pos as a decision of its own, and propagates it.
+template<typename Layout, typename Branching>
+inline bool com_masaers::backjumping_solver<Layout, Branching>::decide(const int pos, const int value) {
+  board_m.apply_mask(pos, sudoku_board<Layout>::make_mask(value), std::back_inserter(agenda_m), trail_m);
+  reasons_m[pos].reset().set(pos);
+  return propagate();
+}
+
+// Propagates the cells on the agenda to their peers, passing on the
+// reasons of the solved cells to the peers they eliminate values
+// from. On failure, conflict_m holds the reason of the failure.
+template<typename Layout, typename Branching>
+bool com_masaers::backjumping_solver<Layout, Branching>::propagate() {
+  bool result = true;
+  while (result && ! agenda_m.empty()) {
+    const int pos = agenda_m.front();
+    agenda_m.pop_front();
+    result = check_nogoods(pos);
+    const cell_type& value = board_m[pos];
+    const position_set reason = reasons_m[pos];
+    for (auto it = Layout::first_peer(pos); result && it != Layout::last_peer(pos); ++it) {
+      if ((board_m[*it] & value).any()) {
+        board_m.apply_mask(*it, ~value, std::back_inserter(agenda_m), trail_m);
+        reasons_m[*it] |= reason;
+        if (board_m[*it].none()) {
+          conflict_m = reasons_m[*it];
+          result = false;
+        }
+      }
+    }
+  }
+  agenda_m.clear();
+  return result;
+}
+
+// Checks the nogoods watched by the placement in the newly solved
+// cell at pos. Returns false, with the reasons of the cells of the
+// nogood as the conflict, if all placements of some nogood hold.
+template<typename Layout, typename Branching>
+bool com_masaers::backjumping_solver<Layout, Branching>::check_nogoods(const int pos) {
+  bool result = true;
+  const std::vector<std::size_t>& watches = watches_m[pos * Layout::N + board_m[pos].first()];
+  for (auto it = watches.begin(); result && it != watches.end(); ++it) {
+    const int* first = &nogoods_m[*it + 1];
+    const int* last = first + nogoods_m[*it];
+    bool holds = true;
+    for (const int* p = first; holds && p != last; ++p) {
+      const int other = *p / Layout::N;
+      holds = board_m.solved(other) && board_m[other][*p % Layout::N];
+    }
+    if (holds) {
+      conflict_m.reset();
+      for (const int* p = first; p != last; ++p) {
+        conflict_m |= reasons_m[*p / Layout::N];
+      }
+      ++cut_m;
+      result = false;
+    }
+  }
+  return result;
+}
+
+// Stores the placements of the decisions in conflict as a nogood.
+template<typename Layout, typename Branching>
+void com_masaers::backjumping_solver<Layout, Branching>::learn(const position_set& conflict) {
+  const int size = conflict.count();
+  if (size != 0 && size <= MAX_NOGOOD_SIZE && learned_m < MAX_NOGOODS) {
+    const std::size_t offset = nogoods_m.size();
+    nogoods_m.push_back(size);
+    for (int pos = conflict.first(); pos < Layout::NN; pos = conflict.next(pos)) {
+      const int placement = pos * Layout::N + board_m[pos].first();
+      nogoods_m.push_back(placement);
+      watches_m[placement].push_back(offset);
+    }
+    ++learned_m;
+  }
+}
+
+// Why the alternatives of a frame are the only ones. Branching on
+// every value of a cell is explained by the reason of the cell, and
+// branching on every place of a value in a unit by the reasons of the
+// other cells of the unit. Anything else depends on every decision.
+template<typename Layout, typename Branching>
+typename com_masaers::backjumping_solver<Layout, Branching>::position_set
+com_masaers::backjumping_solver<Layout, Branching>::explain(const frame_type& frame) const {
+  if (frame.last == 0) {
+    // Some value has no place left in some unit.
+    for (int unit = 0; unit < Layout::UNITS; ++unit) {
+      cell_type values;
+      for (int i = 0; i < Layout::N; ++i) {
+        values |= board_m[Layout::pos_of_unit(unit, i)];
+      }
+      if (values != ~cell_type()) {
+        return explain_unit(unit, (~values).first(), frame);
+      }
+    }
+    return decisions();
+  }
+  const int pos = frame.alternatives[0].first;
+  const int value = frame.alternatives[0].second;
+  bool same_pos = true;
+  bool same_value = true;
+  for (int i = 1; i < frame.last; ++i) {
+    same_pos = same_pos && frame.alternatives[i].first == pos;
+    same_value = same_value && frame.alternatives[i].second == value;
+  }
+  if (same_pos && frame.last == static_cast<int>(board_m[pos].count())) {
+    return reasons_m[pos];
+  }
+  if (same_value) {
+    const int units[3] = {
+      Layout::row_of_pos(pos),
+      Layout::N + Layout::col_of_pos(pos),
+      2 * Layout::N + Layout::house_of_pos(pos)
+    };
+    for (int u = 0; u < 3; ++u) {
+      bool inside = true;
+      for (int i = 1; inside && i < frame.last; ++i) {
+        inside = Layout::unit_mask(units[u])[frame.alternatives[i].first];
+      }
+      int places = 0;
+      for (int i = 0; i < Layout::N; ++i) {
+        const int other = Layout::pos_of_unit(units[u], i);
+        places += ! board_m.solved(other) && board_m[other][value];
+      }
+      if (inside && places == frame.last) {
+        return explain_unit(units[u], value, frame);
+      }
+    }
+  }
+  return decisions();
+}
+
+// The reasons why value is in none of the cells of unit other than
+// the alternatives of frame.
+template<typename Layout, typename Branching>
+typename com_masaers::backjumping_solver<Layout, Branching>::position_set
+com_masaers::backjumping_solver<Layout, Branching>::explain_unit(const int unit, const int value, const frame_type& frame) const {
+  position_set result;
+  for (int i = 0; i < Layout::N; ++i) {
+    const int pos = Layout::pos_of_unit(unit, i);
+    bool alternative = false;
+    for (int j = 0; ! alternative && j < frame.last; ++j) {
+      alternative = frame.alternatives[j].first == pos && frame.alternatives[j].second == value;
+    }
+    if (! alternative) {
+      result |= reasons_m[pos];
+    }
+  }
+  return result;
+}
+
+// Every decision currently in effect.
+template<typename Layout, typename Branching>
+typename com_masaers::backjumping_solver<Layout, Branching>::position_set
+com_masaers::backjumping_solver<Layout, Branching>::decisions() const {
+  position_set result;
+  for (auto it = frames_m.begin(); it != frames_m.end(); ++it) {
+    if (it->decision != -1) {
+      result.set(it->decision);
+    }
+  }
+  return result;
+}
+
+#endif
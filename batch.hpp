@@ -0,0 +1,484 @@
+#ifndef COM_MASAERS_BATCH_HPP
+#define COM_MASAERS_BATCH_HPP
+#include "sudoku.hpp"
+#include "solver.hpp"
+#include "pool.hpp"
+#include "stats.hpp"
+#include "timer.hpp"
+#include "input.hpp"
+#include "output.hpp"
+#include "registry.hpp"
+#include "canonical.hpp"
+#include "cache.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace com_masaers {
+  /**
+     Latency histograms of the phases that batch_solver takes every
+     puzzle through. The cache is only timed for puzzles that are
+     looked up in it, and search only for puzzles that neither the
+     cache nor the trivial solver solves.
+   */
+  class batch_phases {
+  public:
+    enum phase_type { parse, validate, cache, propagate, search, print, PHASES };
+    static const char* phase_name(const phase_type phase);
+    latency_histogram& operator[](const phase_type phase) { return histograms_m[phase]; }
+    const latency_histogram& operator[](const phase_type phase) const { return histograms_m[phase]; }
+    batch_phases& operator+=(const batch_phases& x);
+    // Writes a table of percentile latencies, one row per phase that
+    // any puzzle went through.
+    void print_to(std::ostream& os) const;
+  private:
+    latency_histogram histograms_m[PHASES];
+  }; // batch_phases
+
+  // What a solution_cache keeps for a puzzle: its solution, or that it
+  // has none, both in the canonical form of the puzzle.
+  struct cached_solution {
+    bool solved;
+    sudoku_line solution;
+  }; // cached_solution
+
+  // Solutions of 9x9 puzzles by their canonical forms (see
+  // sudoku_canonicalizer), shared by any number of batch_solvers.
+  typedef lru_cache<sudoku_line, cached_solution, sudoku_line_hash> solution_cache;
+
+  /**
+     Solves puzzles given in the compact one-line format, reusing the
+     same solver instances from one puzzle to the next. Search is the
+     engine used for puzzles that the trivial solver does not solve.
+
+     Stats is the statistics policy (see stats.hpp). Unless it is
+     no_stats, Search must be a depth_first_solver with the same
+     policy, and every output line gets a column with the statistics
+     of its puzzle in JSON.
+
+     A 9x9 solver can be given a solution_cache, in which it looks up
+     puzzles by their canonical form before searching, so that a
+     puzzle that is equivalent to one solved before costs no search.
+     Puzzles that the trivial solver solves, or that have fewer than
+     CACHE_MIN_BLANKS blanks, cost less to solve than to canonicalize,
+     and are not looked up. Solutions of puzzles with more than one
+     may differ from what the search would have found.
+   */
+  template<typename Layout = sudoku_layout<3>, typename Search = depth_first_solver<Layout>, typename Stats = no_stats>
+  class batch_solver {
+  public:
+    enum status_type { solved, unsolvable, invalid, malformed };
+    // Puzzles with fewer blanks than this are not looked up in the
+    // cache. Search is cheap for them, and the many givens make their
+    // canonical forms slow to find.
+    static constexpr int CACHE_MIN_BLANKS = 40;
+    explicit batch_solver(solution_cache* cache = nullptr) : cache_m(std::is_same<Layout, sudoku_layout<3> >::value ? cache : nullptr) {}
+    static const char* status_name(const status_type status);
+    status_type operator()(const char* first, const char* last, std::string& out, const bool print_status);
+    // The statistics of every puzzle solved so far.
+    const run_stats<Stats>& stats() const { return stats_m; }
+    // How long every phase took for every puzzle so far.
+    const batch_phases& phases() const { return phases_m; }
+  protected:
+    sudoku_board<Layout> board_m;
+    trivial_solver<Layout, Stats> trivial_m;
+    Search search_m;
+    run_stats<Stats> stats_m;
+    batch_phases phases_m;
+    solution_cache* cache_m;
+    sudoku_canonicalizer canonical_m;
+  }; // batch_solver
+
+  /**
+     Solves puzzles of every layout in a registry from the same input,
+     in the compact one-line format, telling the layouts apart by the
+     length of the lines. Lines are read a chunk at a time, and within
+     a chunk the puzzles of each layout are solved together by the
+     solvers of that layout, so that their tables and scratch space
+     stay in cache. The output is then written in input order.
+
+     SearchOf<Layout> is the search engine of each layout. Lines of a
+     length that no layout has are handed to the first layout, which
+     reports them as malformed. With more than one thread, the puzzles
+     of a chunk are solved on a pool of workers, in tasks of TASK
+     puzzles of one layout, and every worker has its own solvers.
+   */
+  template<typename Registry, template<typename> class SearchOf, typename Stats = no_stats>
+  class mixed_batch_solver {
+  public:
+    static constexpr std::size_t TASK = 64;
+    // The cache, if any, is used for 9x9 puzzles.
+    explicit mixed_batch_solver(const std::size_t threads, solution_cache* cache = nullptr, const std::size_t chunk = 1 << 12);
+    // Solves every puzzle in the input, one per line, and writes one
+    // line per puzzle to os, in input order. Blank lines and lines
+    // starting with '#' are skipped, and malformed lines are reported
+    // on stderr. Returns true if every puzzle was solved, and adds the
+    // number of puzzles to puzzles.
+    bool operator()(puzzle_reader& in, std::ostream& os, const bool print_status, std::size_t& puzzles);
+    // Solves the lines of a chunk that the caller builds itself: clear()
+    // it, add() the lines, solve() them all, and then read the output
+    // line of every one with output().
+    void clear() { text_m.clear(); count_m = 0; }
+    void add(const char* first, const char* last, const std::size_t line);
+    void solve(const bool print_status) { solve_chunk(print_status); }
+    std::size_t size() const { return count_m; }
+    const std::string& output(const std::size_t i) const { return records_m[i].out; }
+    bool solved(const std::size_t i) const { return records_m[i].solved; }
+    // The statistics and phase latencies of every puzzle solved so
+    // far, of every layout and on all workers.
+    run_stats<Stats> stats() const;
+    batch_phases phases() const;
+  protected:
+    template<typename Layout> using solver_type = batch_solver<Layout, SearchOf<Layout>, Stats>;
+    template<typename Layout> using solvers_type = std::vector<std::unique_ptr<solver_type<Layout> > >;
+    struct record_type {
+      // Where the line is in text_m.
+      std::size_t first;
+      std::size_t size;
+      std::size_t line;
+      int layout;
+      bool known;
+      bool solved;
+      bool malformed;
+      std::string out;
+    };
+    void solve_chunk(const bool print_status);
+    template<typename Layout> void solve_range(const std::size_t worker, const std::size_t first, const std::size_t last, const bool print_status);
+    template<typename Layout> solver_type<Layout>& solver(const std::size_t worker);
+    std::string describe(const std::string& name, const record_type& record) const;
+  private:
+    std::size_t workers_m;
+    std::size_t chunk_m;
+    solution_cache* cache_m;
+    std::unique_ptr<work_stealing_pool> pool_m;
+    typename Registry::template tuple_type<solvers_type> solvers_m;
+    std::string text_m;
+    std::vector<record_type> records_m;
+    std::size_t count_m;
+    // The records of the chunk, grouped by layout.
+    std::vector<std::size_t> order_m;
+  }; // mixed_batch_solver
+} // namespace com_masaers
+
+
+inline const char* com_masaers::batch_phases::phase_name(const phase_type phase) {
+  switch (phase) {
+  case parse: return "parse";
+  case validate: return "validate";
+  case cache: return "cache";
+  case propagate: return "propagate";
+  case search: return "search";
+  default: return "print";
+  }
+}
+
+inline com_masaers::batch_phases& com_masaers::batch_phases::operator+=(const batch_phases& x) {
+  for (int phase = 0; phase < PHASES; ++phase) {
+    histograms_m[phase] += x.histograms_m[phase];
+  }
+  return *this;
+}
+
+inline void com_masaers::batch_phases::print_to(std::ostream& os) const {
+  const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  const std::ios::fmtflags flags = os.flags();
+  const char fill = os.fill(' ');
+  os << std::left << std::setw(10) << "phase" << std::right << std::setw(10) << "count"
+     << std::setw(10) << "p50(us)" << std::setw(10) << "p90(us)" << std::setw(10) << "p99(us)" << std::setw(10) << "p99.9(us)"
+     << std::setw(10) << "max(us)" << std::setw(12) << "total(ms)" << '\n';
+  os << std::fixed << std::setprecision(1);
+  for (int phase = 0; phase < PHASES; ++phase) {
+    const latency_histogram& histogram = histograms_m[phase];
+    if (histogram.count() == 0) {
+      continue;
+    }
+    os << std::left << std::setw(10) << phase_name(phase_type(phase)) << std::right << std::setw(10) << histogram.count();
+    for (const double p : percentiles) {
+      os << std::setw(10) << histogram.percentile(p) / 1e3;
+    }
+    os << std::setw(10) << histogram.max() / 1e3 << std::setw(12) << histogram.total() / 1e6 << '\n';
+  }
+  os.flags(flags);
+  os.fill(fill);
+}
+
+template<typename Layout, typename Search, typename Stats>
+const char* com_masaers::batch_solver<Layout, Search, Stats>::status_name(const status_type status) {
+  switch (status) {
+  case solved: return "solved";
+  case unsolvable: return "unsolvable";
+  case invalid: return "invalid";
+  default: return "malformed";
+  }
+}
+
+// Solves the puzzle in [first, last) and appends one line to out:
+// the solution if there is one, otherwise the input as given,
+// optionally followed by a status column.
+template<typename Layout, typename Search, typename Stats>
+typename com_masaers::batch_solver<Layout, Search, Stats>::status_type
+com_masaers::batch_solver<Layout, Search, Stats>::operator()(const char* first, const char* last, std::string& out, const bool print_status) {
+  status_type result = malformed;
+  Stats puzzle;
+  bool parsed;
+  {
+    scoped_timer timer(phases_m[batch_phases::parse]);
+    parsed = board_m.read_line(first, last);
+  }
+  if (parsed) {
+    bool valid;
+    {
+      scoped_timer timer(phases_m[batch_phases::validate]);
+      valid = board_m.valid();
+    }
+    if (! valid) {
+      result = invalid;
+    } else {
+      sudoku_board<Layout> propagated;
+      {
+        scoped_timer timer(phases_m[batch_phases::propagate]);
+        propagated = trivial_m(board_m);
+      }
+      puzzle = trivial_m.stats();
+      const bool trivial = propagated.valid() && propagated.solved();
+      // The canonical form of the puzzle, and how to get there.
+      sudoku_line key;
+      const sudoku_symmetry* symmetry = nullptr;
+      cached_solution cached;
+      bool hit = false;
+      if constexpr (std::is_same<Layout, sudoku_layout<3> >::value) {
+        if (cache_m != nullptr && ! trivial && board_m.unknown() >= CACHE_MIN_BLANKS) {
+          scoped_timer timer(phases_m[batch_phases::cache]);
+          symmetry = &canonical_m(board_m, key);
+          hit = cache_m->find(key, cached);
+          if (hit && cached.solved) {
+            symmetry->invert(cached.solution, board_m);
+          }
+        }
+      }
+      if (hit) {
+        result = cached.solved ? solved : unsolvable;
+      } else {
+        board_m = propagated;
+        if (! trivial) {
+          scoped_timer timer(phases_m[batch_phases::search]);
+          board_m = search_m(board_m);
+          if constexpr (! std::is_same<Stats, no_stats>::value) {
+            puzzle += search_m.stats();
+          }
+        }
+        result = board_m.valid() && board_m.solved() ? solved : unsolvable;
+        if constexpr (std::is_same<Layout, sudoku_layout<3> >::value) {
+          if (symmetry != nullptr) {
+            cached.solved = result == solved;
+            if (cached.solved) {
+              symmetry->apply(board_m, cached.solution);
+            }
+            cache_m->insert(key, cached);
+          }
+        }
+      }
+      stats_m.add(puzzle);
+    }
+  }
+  scoped_timer timer(phases_m[batch_phases::print]);
+  if (result == solved) {
+    board_m.write_line(back_inserter(out));
+  } else {
+    out.append(first, last);
+  }
+  if (print_status) {
+    out += ' ';
+    out += status_name(result);
+  }
+  if constexpr (! std::is_same<Stats, no_stats>::value) {
+    out += '\t';
+    puzzle.append_json(out);
+  }
+  out += '\n';
+  return result;
+}
+
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::mixed_batch_solver(const std::size_t threads, solution_cache* cache, const std::size_t chunk)
+  : workers_m(threads <= 1 ? 1 : threads)
+  , chunk_m(chunk == 0 ? 1 : chunk)
+  , cache_m(cache)
+  , pool_m(threads <= 1 ? nullptr : new work_stealing_pool(threads))
+  , count_m(0)
+{
+  Registry::for_each([this](auto tag) {
+      typedef typename decltype(tag)::type layout_type;
+      std::get<solvers_type<layout_type> >(solvers_m).resize(workers_m);
+    });
+}
+
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+bool com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::operator()(puzzle_reader& in, std::ostream& os, const bool print_status, std::size_t& puzzles) {
+  bool result = true;
+  const char* first;
+  const char* last;
+  puzzle_writer out(os, puzzle_writer::compact);
+  bool more = true;
+  while (more) {
+    // Copy a chunk of lines, since the reader only keeps the last one.
+    clear();
+    while (count_m < chunk_m && (more = in.next_line(first, last))) {
+      if (first != last && *first != '#') {
+        add(first, last, in.line());
+      }
+    }
+    solve_chunk(print_status);
+    for (std::size_t i = 0; i < count_m; ++i) {
+      const record_type& record = records_m[i];
+      out.buffer() += record.out;
+      out.commit();
+      if (record.malformed) {
+        std::cerr << describe(in.name(), record) << std::endl;
+      }
+      result = record.solved && result;
+    }
+    puzzles += count_m;
+  }
+  if (! in.good()) {
+    std::cerr << in.error() << std::endl;
+    result = false;
+  }
+  out.flush();
+  return result;
+}
+
+// Copies a line into the chunk, and finds its layout.
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+void com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::add(const char* first, const char* last, const std::size_t line) {
+  if (count_m == records_m.size()) {
+    records_m.emplace_back();
+  }
+  record_type& record = records_m[count_m++];
+  record.first = text_m.size();
+  record.size = last - first;
+  record.line = line;
+  record.layout = Registry::index_of_cells(record.size);
+  record.known = record.layout != Registry::SIZE;
+  if (! record.known) {
+    record.layout = 0;
+  }
+  text_m.append(first, last);
+}
+
+// Groups the records of the chunk by layout, and solves every group
+// with the solvers of its layout, a task at a time.
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+void com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::solve_chunk(const bool print_status) {
+  std::size_t starts[Registry::SIZE + 1] = {};
+  for (std::size_t i = 0; i < count_m; ++i) {
+    ++starts[records_m[i].layout + 1];
+  }
+  for (int layout = 0; layout < Registry::SIZE; ++layout) {
+    starts[layout + 1] += starts[layout];
+  }
+  order_m.resize(count_m);
+  {
+    std::size_t next[Registry::SIZE];
+    std::copy(starts, starts + Registry::SIZE, next);
+    for (std::size_t i = 0; i < count_m; ++i) {
+      order_m[next[records_m[i].layout]++] = i;
+    }
+  }
+  for (int layout = 0; layout < Registry::SIZE; ++layout) {
+    Registry::visit(layout, [&](auto tag) {
+        typedef typename decltype(tag)::type layout_type;
+        for (std::size_t first = starts[layout]; first < starts[layout + 1]; first += TASK) {
+          const std::size_t last = std::min(first + TASK, starts[layout + 1]);
+          if (pool_m) {
+            pool_m->submit([this, first, last, print_status](const std::size_t worker) {
+                solve_range<layout_type>(worker, first, last, print_status);
+              });
+          } else {
+            solve_range<layout_type>(0, first, last, print_status);
+          }
+        }
+      });
+  }
+  if (pool_m) {
+    pool_m->wait();
+  }
+}
+
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+template<typename Layout>
+void com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::solve_range(const std::size_t worker, const std::size_t first, const std::size_t last, const bool print_status) {
+  solver_type<Layout>& solve = solver<Layout>(worker);
+  for (std::size_t i = first; i != last; ++i) {
+    record_type& record = records_m[order_m[i]];
+    const char* text = text_m.data() + record.first;
+    record.out.clear();
+    const typename solver_type<Layout>::status_type status = solve(text, text + record.size, record.out, print_status);
+    record.solved = status == solver_type<Layout>::solved;
+    record.malformed = status == solver_type<Layout>::malformed;
+  }
+}
+
+// The solver of a layout on a worker, made the first time that the
+// worker meets a puzzle of the layout.
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+template<typename Layout>
+typename com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::template solver_type<Layout>&
+com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::solver(const std::size_t worker) {
+  std::unique_ptr<solver_type<Layout> >& result = std::get<solvers_type<Layout> >(solvers_m)[worker];
+  if (! result) {
+    result.reset(new solver_type<Layout>(cache_m));
+  }
+  return *result;
+}
+
+// Says what is wrong with a malformed record.
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+std::string com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::describe(const std::string& name, const record_type& record) const {
+  std::string result = name + ":" + std::to_string(record.line) + ": ";
+  if (! record.known) {
+    result += "found " + std::to_string(record.size) + " cells, which is no board of " + Registry::names() + ".";
+  } else {
+    const char* text = text_m.data() + record.first;
+    Registry::visit(record.layout, [&](auto tag) {
+        result += line_error<typename decltype(tag)::type>(text, text + record.size);
+      });
+  }
+  return result;
+}
+
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+com_masaers::run_stats<Stats> com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::stats() const {
+  run_stats<Stats> result;
+  Registry::for_each([&](auto tag) {
+      typedef typename decltype(tag)::type layout_type;
+      for (const auto& solver : std::get<solvers_type<layout_type> >(solvers_m)) {
+        if (solver) {
+          result += solver->stats();
+        }
+      }
+    });
+  return result;
+}
+
+template<typename Registry, template<typename> class SearchOf, typename Stats>
+com_masaers::batch_phases com_masaers::mixed_batch_solver<Registry, SearchOf, Stats>::phases() const {
+  batch_phases result;
+  Registry::for_each([&](auto tag) {
+      typedef typename decltype(tag)::type layout_type;
+      for (const auto& solver : std::get<solvers_type<layout_type> >(solvers_m)) {
+        if (solver) {
+          result += solver->phases();
+        }
+      }
+    });
+  return result;
+}
+
+#endif
@@ -0,0 +1,292 @@
+#include "sudoku.hpp"
+#include "pseudoku.hpp"
+#include "solver.hpp"
+#include "propagation.hpp"
+#include "bitboard.hpp"
+#include "dlx.hpp"
+#include "backjump.hpp"
+#include "generator.hpp"
+#include "timer.hpp"
+#include "input.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+typedef com_masaers::sudoku_layout<3> layout_type;
+
+template<typename Layout = layout_type>
+struct corpus_type {
+  std::string name;
+  std::vector<com_masaers::sudoku_board<Layout> > boards;
+};
+
+struct result_type {
+  std::string corpus;
+  std::string engine;
+  std::size_t puzzles;
+  std::size_t solved;
+  std::size_t reps;
+  std::uint64_t min_ns;
+  std::uint64_t median_ns;
+  std::uint64_t p99_ns;
+  std::uint64_t total_ns;
+  std::uint64_t nodes;
+};
+
+// Runs solve over every board of the corpus, warmup times untimed and
+// then reps times timed one board at a time. Solve returns whether it
+// solved the board, and adds the nodes it searched to its argument.
+template<typename Layout, typename Solve>
+result_type run(const corpus_type<Layout>& corpus, const std::string& engine, const std::size_t warmup, const std::size_t reps, Solve&& solve) {
+  using namespace com_masaers;
+  result_type result = { corpus.name, engine, corpus.boards.size(), 0, reps, 0, 0, 0, 0, 0 };
+  std::vector<std::uint64_t> latencies;
+  latencies.reserve(reps * corpus.boards.size());
+  std::uint64_t nodes = 0;
+  for (std::size_t i = 0; i < warmup; ++i) {
+    for (auto it = corpus.boards.begin(); it != corpus.boards.end(); ++it) {
+      solve(*it, nodes);
+    }
+  }
+  for (std::size_t i = 0; i < reps; ++i) {
+    result.solved = 0;
+    for (auto it = corpus.boards.begin(); it != corpus.boards.end(); ++it) {
+      timer t;
+      t.start();
+      const bool solved = solve(*it, result.nodes);
+      t.stop();
+      latencies.push_back(t.ns());
+      result.solved += solved ? 1 : 0;
+    }
+  }
+  if (! latencies.empty()) {
+    for (auto it = latencies.begin(); it != latencies.end(); ++it) {
+      result.total_ns += *it;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    result.min_ns = latencies.front();
+    result.median_ns = latencies[(latencies.size() - 1) / 2];
+    result.p99_ns = latencies[(latencies.size() * 99 + 99) / 100 - 1];
+  }
+  return result;
+}
+
+// Solves with the trivial solver, and then with search if that is not
+// enough, which is how batch mode solves every puzzle.
+template<typename Layout, typename Search>
+struct search_engine {
+  com_masaers::trivial_solver<Layout> trivial;
+  Search search;
+  bool operator()(const com_masaers::sudoku_board<Layout>& board, std::uint64_t& nodes) {
+    bool result = true;
+    const com_masaers::sudoku_board<Layout> propagated = trivial(board);
+    if (! propagated.solved()) {
+      result = ! search(propagated, 1).empty();
+      nodes += search.nodes();
+    }
+    return result;
+  }
+};
+
+// Runs every engine over the corpus. The bitboard engine only exists
+// for 9x9 boards.
+template<typename Layout>
+void run_engines(const corpus_type<Layout>& corpus, const std::size_t warmup, const std::size_t reps, std::vector<result_type>& results) {
+  using namespace com_masaers;
+  typedef sudoku_board<Layout> board_type;
+  trivial_solver<Layout> trivial;
+  pseudoku_solver<Layout> pseudoku;
+  results.push_back(run(corpus, "trivial", warmup, reps, [&](const board_type& board, std::uint64_t&) {
+        return trivial(board).solved();
+      }));
+  results.push_back(run(corpus, "pseudoku", warmup, reps, [&](const board_type& board, std::uint64_t&) {
+        board_type propagated = trivial(board);
+        pseudoku(propagated);
+        return propagated.solved();
+      }));
+  search_engine<Layout, depth_first_solver<Layout> > naked;
+  results.push_back(run(corpus, "depth_first", warmup, reps, naked));
+  search_engine<Layout, depth_first_solver<Layout, hidden_candidate_branching, hidden_single_propagation<Layout> > > hidden;
+  results.push_back(run(corpus, "depth_first_hidden", warmup, reps, hidden));
+  search_engine<Layout, depth_first_solver<Layout, hidden_candidate_branching, pseudoku_propagation<Layout> > > full;
+  results.push_back(run(corpus, "depth_first_full", warmup, reps, full));
+  if constexpr (std::is_same<Layout, layout_type>::value) {
+    search_engine<Layout, bitboard_solver> bitboard;
+    results.push_back(run(corpus, "bitboard", warmup, reps, bitboard));
+  }
+  search_engine<Layout, dlx_solver<Layout> > dlx;
+  results.push_back(run(corpus, "dlx", warmup, reps, dlx));
+  search_engine<Layout, backjumping_solver<Layout> > backjump;
+  results.push_back(run(corpus, "backjump", warmup, reps, backjump));
+}
+
+// Reads a grid format board from every file.
+bool read_grids(const std::vector<const char*>& files, corpus_type<>& corpus) {
+  bool result = true;
+  for (auto it = files.begin(); it != files.end(); ++it) {
+    com_masaers::puzzle_reader in(*it);
+    corpus.boards.emplace_back();
+    if (in.next_grid(corpus.boards.back()) != com_masaers::puzzle_reader::read) {
+      std::cerr << (in.good() ? std::string(*it) + ": no board." : in.error()) << std::endl;
+      result = false;
+    }
+  }
+  return result;
+}
+
+// Reads every line of a one-line-per-puzzle file.
+bool read_lines(const char* path, corpus_type<>& corpus) {
+  bool result = true;
+  std::ifstream file(path);
+  std::string line;
+  if (! file) {
+    std::cerr << "Could not open " << path << "." << std::endl;
+    result = false;
+  }
+  while (result && std::getline(file, line)) {
+    if (! line.empty() && line[line.size() - 1] == '\r') {
+      line.erase(line.size() - 1);
+    }
+    if (! line.empty()) {
+      corpus.boards.emplace_back();
+      if (! corpus.boards.back().read_line(line.data(), line.data() + line.size())) {
+        std::cerr << path << ": malformed line " << corpus.boards.size() << "." << std::endl;
+        result = false;
+      }
+    }
+  }
+  return result;
+}
+
+// Generates count puzzles from a fixed seed, so that every run
+// benchmarks the same puzzles. Search is the engine that checks for
+// uniqueness.
+template<typename Layout, typename Search>
+void generate(const std::size_t count, const int clues, const bool hard, corpus_type<Layout>& corpus) {
+  using namespace com_masaers;
+  puzzle_generator<Layout, Search> generator(clues, hard);
+  corpus.boards.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    generator(1, i, corpus.boards[i]);
+  }
+}
+
+// Generates a corpus of a larger layout with a target number of clues,
+// and runs every engine over it. Digging large boards down to minimal
+// puzzles takes far too long, so all but the smallest stop at a
+// number of clues that still leaves a search to do.
+template<typename Layout>
+void run_large(const std::size_t count, const int clues, const std::size_t warmup, const std::size_t reps, std::vector<result_type>& results) {
+  using namespace com_masaers;
+  corpus_type<Layout> corpus = { "generated_" + std::to_string(Layout::N) + "x" + std::to_string(Layout::N), {} };
+  generate<Layout, dlx_solver<Layout> >(count, clues, false, corpus);
+  std::cerr << "Benchmarking " << corpus.name << " (" << corpus.boards.size() << " puzzles)..." << std::endl;
+  run_engines(corpus, warmup, reps, results);
+}
+
+
+int main(const int argc, const char** argv) {
+  using namespace std;
+  using namespace com_masaers;
+
+  size_t warmup = 1;
+  size_t reps = 5;
+  size_t generated = 1000;
+  size_t hard = 100;
+  size_t large = 10;
+  string label = "-";
+  const char* out_path = nullptr;
+  vector<const char*> grid_files;
+  vector<const char*> line_files;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--warmup=", 9) == 0) {
+      warmup = strtoul(argv[i] + 9, nullptr, 10);
+    } else if (strncmp(argv[i], "--reps=", 7) == 0) {
+      reps = strtoul(argv[i] + 7, nullptr, 10);
+    } else if (strncmp(argv[i], "--generated=", 12) == 0) {
+      generated = strtoul(argv[i] + 12, nullptr, 10);
+    } else if (strncmp(argv[i], "--hard=", 7) == 0) {
+      hard = strtoul(argv[i] + 7, nullptr, 10);
+    } else if (strncmp(argv[i], "--large=", 8) == 0) {
+      large = strtoul(argv[i] + 8, nullptr, 10);
+    } else if (strncmp(argv[i], "--label=", 8) == 0) {
+      label = argv[i] + 8;
+    } else if (strncmp(argv[i], "--out=", 6) == 0) {
+      out_path = argv[i] + 6;
+    } else if (strncmp(argv[i], "--lines=", 8) == 0) {
+      line_files.push_back(argv[i] + 8);
+    } else {
+      grid_files.push_back(argv[i]);
+    }
+  }
+
+  vector<corpus_type<> > corpora;
+  bool ok = true;
+  if (! grid_files.empty()) {
+    corpora.push_back(corpus_type<>{ "grids", {} });
+    ok = read_grids(grid_files, corpora.back()) && ok;
+  }
+  for (auto it = line_files.begin(); it != line_files.end(); ++it) {
+    corpora.push_back(corpus_type<>{ *it, {} });
+    ok = read_lines(*it, corpora.back()) && ok;
+  }
+  if (generated != 0) {
+    corpora.push_back(corpus_type<>{ "generated", {} });
+    generate<layout_type, bitboard_solver>(generated, 0, false, corpora.back());
+  }
+  if (hard != 0) {
+    corpora.push_back(corpus_type<>{ "generated_hard", {} });
+    generate<layout_type, bitboard_solver>(hard, 0, true, corpora.back());
+  }
+  if (! ok) {
+    return EXIT_FAILURE;
+  }
+
+  vector<result_type> results;
+  for (auto it = corpora.begin(); it != corpora.end(); ++it) {
+    cerr << "Benchmarking " << it->name << " (" << it->boards.size() << " puzzles)..." << endl;
+    run_engines(*it, warmup, reps, results);
+  }
+  if (large != 0) {
+    run_large<sudoku_layout<3, 4> >(large, 0, warmup, reps, results);
+    run_large<sudoku_layout<4> >(large, 110, warmup, reps, results);
+    run_large<sudoku_layout<5> >(large, 340, warmup, reps, results);
+    run_large<sudoku_layout<6> >(large, 780, warmup, reps, results);
+  }
+
+  // A table for people on stdout, and tab separated values with raw
+  // nanoseconds for scripts in the output file.
+  cout << left << setw(16) << "corpus" << setw(20) << "engine"
+       << right << setw(9) << "solved" << setw(12) << "min(us)" << setw(12) << "median(us)" << setw(12) << "p99(us)"
+       << setw(14) << "puzzles/s" << setw(14) << "nodes/s" << endl;
+  for (auto it = results.begin(); it != results.end(); ++it) {
+    const double seconds = it->total_ns / 1e9;
+    cout << left << setw(16) << it->corpus.substr(0, 15) << setw(20) << it->engine
+         << right << setw(9) << it->solved << fixed << setprecision(1)
+         << setw(12) << it->min_ns / 1e3 << setw(12) << it->median_ns / 1e3 << setw(12) << it->p99_ns / 1e3
+         << setprecision(0)
+         << setw(14) << (seconds > 0 ? it->puzzles * it->reps / seconds : 0)
+         << setw(14) << (seconds > 0 ? it->nodes / seconds : 0) << endl;
+  }
+  if (out_path != nullptr) {
+    ofstream out(out_path);
+    out << "label\tcorpus\tengine\tpuzzles\tsolved\treps\tmin_ns\tmedian_ns\tp99_ns\ttotal_ns\tnodes" << '\n';
+    for (auto it = results.begin(); it != results.end(); ++it) {
+      out << label << '\t' << it->corpus << '\t' << it->engine << '\t' << it->puzzles << '\t' << it->solved << '\t' << it->reps
+          << '\t' << it->min_ns << '\t' << it->median_ns << '\t' << it->p99_ns << '\t' << it->total_ns << '\t' << it->nodes << '\n';
+    }
+    if (! out) {
+      cerr << "Could not write " << out_path << "." << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
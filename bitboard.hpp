@@ -0,0 +1,504 @@
+#ifndef COM_MASAERS_BITBOARD_HPP
+#define COM_MASAERS_BITBOARD_HPP
+#include "sudoku.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__) && ! defined(COM_MASAERS_NO_SIMD)
+#define COM_MASAERS_BITBOARD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace com_masaers {
+  /**
+     Four 32-bit lanes, one per band of a 9x9 board (the fourth lane is
+     always zero). Within a band, the cell in row r (of the band) and
+     column c is bit r * 9 + c. Uses SSE2 where available, and plain
+     loops otherwise.
+   */
+  class band_vector {
+  public:
+    band_vector();
+    band_vector(const std::uint32_t b0, const std::uint32_t b1, const std::uint32_t b2);
+    std::uint32_t lane(const int band) const;
+    bool none() const;
+    // Bit b is set if lane b (for b < 3) is zero.
+    int zero_lanes() const;
+    band_vector operator&(const band_vector& x) const;
+    band_vector operator|(const band_vector& x) const;
+    band_vector& operator&=(const band_vector& x) { return *this = *this & x; }
+    band_vector& operator|=(const band_vector& x) { return *this = *this | x; }
+    // Bits of *this that are not in x.
+    band_vector but(const band_vector& x) const;
+    // Every lane minus one.
+    band_vector decremented() const;
+    // All ones in the lanes that are zero, zero elsewhere.
+    band_vector zero_mask() const;
+  private:
+#if defined(COM_MASAERS_BITBOARD_SSE2)
+    explicit band_vector(const __m128i v) : v_m(v) {}
+    __m128i v_m;
+#else
+    std::uint32_t v_m[4];
+#endif
+  }; // band_vector
+
+
+  /**
+     A solver specialized for 9x9 boards. Candidates are stored per
+     digit as 81-bit boards split into three 27-bit bands, so that
+     placing a digit, finding naked singles and finding hidden singles
+     in rows and houses are a few operations over whole bands at once.
+     Searches depth first, branching on a digit with two positions left
+     in some unit, or a cell with two candidates, when there is one.
+
+     Has the same interface as depth_first_solver. Every node on the
+     frontier adds at most nine alternatives, and is one of at most 81
+     levels, so the frontier is made large enough for any search up
+     front, and visit() allocates nothing.
+   */
+  class bitboard_solver {
+  public:
+    typedef sudoku_layout<3> layout_type;
+    bitboard_solver() { frontier_m.reserve(81 * 9); }
+    const sudoku_board<layout_type>& operator()(const sudoku_board<layout_type>& board);
+    const std::vector<sudoku_board<layout_type> >& operator()(const sudoku_board<layout_type>& board, std::size_t solutions);
+    // Calls visitor with every solution as it is found, until it
+    // returns false, as depth_first_solver::visit does.
+    template<typename Visitor> std::size_t visit(const sudoku_board<layout_type>& board, Visitor&& visitor);
+    // The number of nodes entered by the last search.
+    std::size_t nodes() const { return nodes_m; }
+  protected:
+    struct state_type {
+      band_vector digits[9];
+      band_vector solved;
+      bool assign(const int digit, const int pos);
+      bool propagate();
+      bool naked_singles(bool& changed);
+      bool hidden_singles(bool& changed);
+      int branch(std::pair<int, int>* alternatives) const;
+      bool done() const;
+    }; // state_type
+    struct tables_type {
+      tables_type();
+      band_vector cells[81];
+      band_vector peers[81];
+      band_vector units[6];
+      band_vector all;
+    }; // tables_type
+    static const tables_type& tables();
+    static int pos_of_bit(const int band, const int bit) { return band * 27 + bit; }
+    bool load(const sudoku_board<layout_type>& board, state_type& state) const;
+    void store(const state_type& state, sudoku_board<layout_type>& board) const;
+    void depth_first(const state_type& root, std::size_t solutions);
+    template<typename Solution> void search(const state_type& root, Solution&& solution);
+  private:
+    std::vector<state_type> frontier_m;
+    sudoku_board<layout_type> board_m;
+    std::vector<sudoku_board<layout_type> > solutions_m;
+    std::size_t nodes_m = 0;
+  }; // bitboard_solver
+} // namespace com_masaers
+
+
+#if defined(COM_MASAERS_BITBOARD_SSE2)
+inline com_masaers::band_vector::band_vector() : v_m(_mm_setzero_si128()) {}
+inline com_masaers::band_vector::band_vector(const std::uint32_t b0, const std::uint32_t b1, const std::uint32_t b2)
+  : v_m(_mm_set_epi32(0, static_cast<int>(b2), static_cast<int>(b1), static_cast<int>(b0))) {}
+inline std::uint32_t com_masaers::band_vector::lane(const int band) const {
+  alignas(16) std::uint32_t lanes[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v_m);
+  return lanes[band];
+}
+inline bool com_masaers::band_vector::none() const {
+  return _mm_movemask_epi8(_mm_cmpeq_epi32(v_m, _mm_setzero_si128())) == 0xFFFF;
+}
+inline int com_masaers::band_vector::zero_lanes() const {
+  return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v_m, _mm_setzero_si128()))) & 7;
+}
+inline com_masaers::band_vector com_masaers::band_vector::operator&(const band_vector& x) const {
+  return band_vector(_mm_and_si128(v_m, x.v_m));
+}
+inline com_masaers::band_vector com_masaers::band_vector::operator|(const band_vector& x) const {
+  return band_vector(_mm_or_si128(v_m, x.v_m));
+}
+inline com_masaers::band_vector com_masaers::band_vector::but(const band_vector& x) const {
+  return band_vector(_mm_andnot_si128(x.v_m, v_m));
+}
+inline com_masaers::band_vector com_masaers::band_vector::decremented() const {
+  return band_vector(_mm_sub_epi32(v_m, _mm_set1_epi32(1)));
+}
+inline com_masaers::band_vector com_masaers::band_vector::zero_mask() const {
+  return band_vector(_mm_cmpeq_epi32(v_m, _mm_setzero_si128()));
+}
+#else
+inline com_masaers::band_vector::band_vector() : v_m() {}
+inline com_masaers::band_vector::band_vector(const std::uint32_t b0, const std::uint32_t b1, const std::uint32_t b2) {
+  v_m[0] = b0; v_m[1] = b1; v_m[2] = b2; v_m[3] = 0;
+}
+inline std::uint32_t com_masaers::band_vector::lane(const int band) const {
+  return v_m[band];
+}
+inline bool com_masaers::band_vector::none() const {
+  return (v_m[0] | v_m[1] | v_m[2] | v_m[3]) == 0;
+}
+inline int com_masaers::band_vector::zero_lanes() const {
+  return (v_m[0] == 0 ? 1 : 0) | (v_m[1] == 0 ? 2 : 0) | (v_m[2] == 0 ? 4 : 0);
+}
+inline com_masaers::band_vector com_masaers::band_vector::operator&(const band_vector& x) const {
+  band_vector result;
+  for (int i = 0; i < 4; ++i) { result.v_m[i] = v_m[i] & x.v_m[i]; }
+  return result;
+}
+inline com_masaers::band_vector com_masaers::band_vector::operator|(const band_vector& x) const {
+  band_vector result;
+  for (int i = 0; i < 4; ++i) { result.v_m[i] = v_m[i] | x.v_m[i]; }
+  return result;
+}
+inline com_masaers::band_vector com_masaers::band_vector::but(const band_vector& x) const {
+  band_vector result;
+  for (int i = 0; i < 4; ++i) { result.v_m[i] = v_m[i] & ~x.v_m[i]; }
+  return result;
+}
+inline com_masaers::band_vector com_masaers::band_vector::decremented() const {
+  band_vector result;
+  for (int i = 0; i < 4; ++i) { result.v_m[i] = v_m[i] - 1; }
+  return result;
+}
+inline com_masaers::band_vector com_masaers::band_vector::zero_mask() const {
+  band_vector result;
+  for (int i = 0; i < 4; ++i) { result.v_m[i] = v_m[i] == 0 ? ~std::uint32_t(0) : 0; }
+  return result;
+}
+#endif
+
+
+inline com_masaers::bitboard_solver::tables_type::tables_type() {
+  static const std::uint32_t band = (1u << 27) - 1;
+  all = band_vector(band, band, band);
+  for (int pos = 0; pos < 81; ++pos) {
+    const int b = pos / 27;
+    const int bit = pos % 27;
+    const int col = pos % 9;
+    const std::uint32_t row_mask = 0x1FFu << (bit / 9 * 9);
+    const std::uint32_t house_mask = 0x1C0E07u << (col / 3 * 3);
+    const std::uint32_t col_mask = 0x40201u << col;
+    std::uint32_t lanes[3] = { col_mask, col_mask, col_mask };
+    lanes[b] = (row_mask | house_mask | col_mask) & ~(1u << bit);
+    peers[pos] = band_vector(lanes[0], lanes[1], lanes[2]);
+    lanes[0] = lanes[1] = lanes[2] = 0;
+    lanes[b] = 1u << bit;
+    cells[pos] = band_vector(lanes[0], lanes[1], lanes[2]);
+  }
+  for (int i = 0; i < 3; ++i) {
+    const std::uint32_t row_mask = 0x1FFu << (i * 9);
+    const std::uint32_t house_mask = 0x1C0E07u << (i * 3);
+    units[i] = band_vector(row_mask, row_mask, row_mask);
+    units[3 + i] = band_vector(house_mask, house_mask, house_mask);
+  }
+}
+
+inline const com_masaers::bitboard_solver::tables_type& com_masaers::bitboard_solver::tables() {
+  static const tables_type result;
+  return result;
+}
+
+// Places digit at pos, removing it from all peers and removing all
+// other digits from pos. Returns false if digit was not a candidate.
+inline bool com_masaers::bitboard_solver::state_type::assign(const int digit, const int pos) {
+  const tables_type& t = tables();
+  bool result = ! (digits[digit] & t.cells[pos]).none();
+  if (result) {
+    for (int d = 0; d < 9; ++d) {
+      digits[d] = digits[d].but(t.cells[pos]);
+    }
+    digits[digit] = digits[digit].but(t.peers[pos]) | t.cells[pos];
+    solved |= t.cells[pos];
+  }
+  return result;
+}
+
+inline bool com_masaers::bitboard_solver::state_type::done() const {
+  return tables().all.but(solved).none();
+}
+
+// Places every cell that has a single candidate left. Returns false
+// if some cell has no candidates left.
+inline bool com_masaers::bitboard_solver::state_type::naked_singles(bool& changed) {
+  band_vector one;
+  band_vector two;
+  for (int d = 0; d < 9; ++d) {
+    two |= one & digits[d];
+    one |= digits[d];
+  }
+  bool result = tables().all.but(one).none();
+  const band_vector singles = one.but(two).but(solved);
+  for (int b = 0; result && b < 3; ++b) {
+    for (std::uint32_t bits = singles.lane(b); result && bits != 0; bits &= bits - 1) {
+      const int pos = pos_of_bit(b, lowest_bit_word(bits));
+      const band_vector& cell = tables().cells[pos];
+      if ((solved & cell).none()) {
+        int digit = 0;
+        while (digit < 9 && (digits[digit] & cell).none()) {
+          ++digit;
+        }
+        result = digit < 9 && assign(digit, pos);
+        changed = true;
+      }
+    }
+  }
+  return result;
+}
+
+// Places every digit that has a single position left in some row,
+// column or house. Returns false if some digit has no position left
+// in some unit.
+inline bool com_masaers::bitboard_solver::state_type::hidden_singles(bool& changed) {
+  const tables_type& t = tables();
+  bool result = true;
+  for (int d = 0; result && d < 9; ++d) {
+    // Rows and houses lie within bands, so all bands at once.
+    band_vector empty;
+    band_vector singles;
+    for (int u = 0; u < 6; ++u) {
+      const band_vector m = digits[d] & t.units[u];
+      const band_vector zero = m.zero_mask();
+      empty |= zero;
+      singles |= m & (m & m.decremented()).zero_mask().but(zero);
+    }
+    result = empty.zero_lanes() == 7;
+    // Columns span the bands, so fold the nine rows bit-sliced.
+    std::uint32_t col_one = 0;
+    std::uint32_t col_two = 0;
+    for (int b = 0; b < 3; ++b) {
+      const std::uint32_t bits = digits[d].lane(b);
+      for (int r = 0; r < 27; r += 9) {
+        const std::uint32_t row = (bits >> r) & 0x1FF;
+        col_two |= col_one & row;
+        col_one |= row;
+      }
+    }
+    result = result && col_one == 0x1FF;
+    const std::uint32_t col_singles = col_one & ~col_two;
+    if (result && col_singles != 0) {
+      const std::uint32_t spread = col_singles | (col_singles << 9) | (col_singles << 18);
+      singles |= digits[d] & band_vector(spread, spread, spread);
+    }
+    singles = singles.but(solved);
+    for (int b = 0; result && b < 3; ++b) {
+      for (std::uint32_t bits = singles.lane(b); result && bits != 0; bits &= bits - 1) {
+        const int pos = pos_of_bit(b, lowest_bit_word(bits));
+        if ((solved & t.cells[pos]).none()) {
+          result = assign(d, pos);
+          changed = true;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+inline bool com_masaers::bitboard_solver::state_type::propagate() {
+  bool result = true;
+  bool changed = true;
+  while (result && changed) {
+    changed = false;
+    result = naked_singles(changed);
+    if (result && ! changed) {
+      result = hidden_singles(changed);
+    }
+  }
+  return result;
+}
+
+// Writes the (position, digit) alternatives to branch on, and
+// returns how many there are. These are the positions of the digit
+// with the fewest within a row, column or house if that is at most
+// two, else the candidates of a cell with exactly two, else the
+// positions of that digit after all.
+inline int com_masaers::bitboard_solver::state_type::branch(std::pair<int, int>* alternatives) const {
+  const tables_type& t = tables();
+  // The digit and unit with the fewest positions. Rows and houses are
+  // band lanes under a unit mask, columns are a mask in every lane.
+  int best = 10;
+  int best_digit = -1;
+  band_vector best_unit;
+  for (int d = 0; best > 2 && d < 9; ++d) {
+    const band_vector open = digits[d].but(solved);
+    const band_vector placed = digits[d] & solved;
+    for (int b = 0; b < 3; ++b) {
+      for (int u = 0; u < 6; ++u) {
+        const std::uint32_t mask = t.units[u].lane(b);
+        if ((placed.lane(b) & mask) == 0) {
+          const int count = popcount_word(open.lane(b) & mask);
+          if (count < best) {
+            best = count;
+            best_digit = d;
+            std::uint32_t lanes[3] = { 0, 0, 0 };
+            lanes[b] = mask;
+            best_unit = band_vector(lanes[0], lanes[1], lanes[2]);
+          }
+        }
+      }
+    }
+    for (int col = 0; col < 9; ++col) {
+      const std::uint32_t mask = 0x40201u << col;
+      const band_vector unit(mask, mask, mask);
+      if ((placed & unit).none()) {
+        const band_vector m = open & unit;
+        const int count = popcount_word(m.lane(0)) + popcount_word(m.lane(1)) + popcount_word(m.lane(2));
+        if (count < best) {
+          best = count;
+          best_digit = d;
+          best_unit = unit;
+        }
+      }
+    }
+  }
+  int result = 0;
+  if (best > 2) {
+    // No digit has two positions left anywhere, so look for a cell
+    // with two candidates. If there is none, the digit and unit found
+    // above are branched on below.
+    band_vector one;
+    band_vector two;
+    band_vector three;
+    for (int d = 0; d < 9; ++d) {
+      three |= two & digits[d];
+      two |= one & digits[d];
+      one |= digits[d];
+    }
+    const band_vector pairs = two.but(three).but(solved);
+    int pos = -1;
+    for (int b = 0; pos == -1 && b < 3; ++b) {
+      if (pairs.lane(b) != 0) {
+        pos = pos_of_bit(b, lowest_bit_word(pairs.lane(b)));
+      }
+    }
+    if (pos != -1) {
+      for (int d = 0; d < 9; ++d) {
+        if (! (digits[d] & t.cells[pos]).none()) {
+          alternatives[result++] = std::make_pair(pos, d);
+        }
+      }
+    }
+  }
+  if (result == 0) {
+    const band_vector m = digits[best_digit].but(solved) & best_unit;
+    for (int b = 0; b < 3; ++b) {
+      for (std::uint32_t bits = m.lane(b); bits != 0; bits &= bits - 1) {
+        alternatives[result++] = std::make_pair(pos_of_bit(b, lowest_bit_word(bits)), best_digit);
+      }
+    }
+  }
+  return result;
+}
+
+inline bool com_masaers::bitboard_solver::load(const sudoku_board<layout_type>& board, state_type& state) const {
+  // Board positions are row major, which is also how bands are laid
+  // out, so position and band bit coincide.
+  std::uint32_t lanes[9][3] = { { 0 } };
+  bool result = true;
+  for (int pos = 0; pos < 81; ++pos) {
+    const layout_type::cell_type& cell = board[pos];
+    // A cell with no values left fails the board here, before any
+    // assignment, rather than in the first naked_singles().
+    result = result && cell.any();
+    for (int d = cell.first(); d < 9; d = cell.next(d)) {
+      lanes[d][pos / 27] |= 1u << (pos % 27);
+    }
+  }
+  for (int d = 0; d < 9; ++d) {
+    state.digits[d] = band_vector(lanes[d][0], lanes[d][1], lanes[d][2]);
+  }
+  state.solved = band_vector();
+  for (int pos = 0; result && pos < 81; ++pos) {
+    if (board.solved(pos)) {
+      result = state.assign(board[pos].first(), pos);
+    }
+  }
+  return result;
+}
+
+inline void com_masaers::bitboard_solver::store(const state_type& state, sudoku_board<layout_type>& board) const {
+  char line[81];
+  for (int pos = 0; pos < 81; ++pos) {
+    const band_vector& cell = tables().cells[pos];
+    int digit = 0;
+    while (digit < 9 && (state.digits[digit] & cell).none()) {
+      ++digit;
+    }
+    line[pos] = digit < 9 ? '1' + digit : '.';
+  }
+  board.read_line(line, line + 81);
+}
+
+inline const com_masaers::sudoku_board<com_masaers::bitboard_solver::layout_type>& com_masaers::bitboard_solver::operator()(const sudoku_board<layout_type>& board) {
+  operator()(board, 1);
+  if (solutions_m.empty()) {
+    return board;
+  } else {
+    return solutions_m.front();
+  }
+}
+
+inline const std::vector<com_masaers::sudoku_board<com_masaers::bitboard_solver::layout_type> >& com_masaers::bitboard_solver::operator()(const sudoku_board<layout_type>& board, std::size_t solutions) {
+  solutions_m.clear();
+  nodes_m = 0;
+  state_type root;
+  if (solutions != 0 && load(board, root)) {
+    depth_first(root, solutions);
+  }
+  return solutions_m;
+}
+
+template<typename Visitor>
+std::size_t com_masaers::bitboard_solver::visit(const sudoku_board<layout_type>& board, Visitor&& visitor) {
+  std::size_t result = 0;
+  nodes_m = 0;
+  state_type root;
+  if (load(board, root)) {
+    search(root, [&](const state_type& state) {
+        store(state, board_m);
+        ++result;
+        return visitor(static_cast<const sudoku_board<layout_type>&>(board_m));
+      });
+  }
+  return result;
+}
+
+inline void com_masaers::bitboard_solver::depth_first(const state_type& root, std::size_t solutions) {
+  search(root, [&](const state_type& state) {
+      solutions_m.emplace_back();
+      store(state, solutions_m.back());
+      return solutions_m.size() < solutions;
+    });
+}
+
+// Searches the tree under root, and passes every solution to
+// solution(), which returns whether to go on.
+template<typename Solution>
+void com_masaers::bitboard_solver::search(const state_type& root, Solution&& solution) {
+  frontier_m.clear();
+  frontier_m.emplace_back(root);
+  while (! frontier_m.empty()) {
+    state_type state = frontier_m.back();
+    frontier_m.pop_back();
+    ++nodes_m;
+    if (state.propagate()) {
+      if (state.done()) {
+        if (! solution(state)) {
+          break;
+        }
+      } else {
+        std::pair<int, int> alternatives[9];
+        for (int i = state.branch(alternatives); i > 0; --i) {
+          frontier_m.emplace_back(state);
+          frontier_m.back().assign(alternatives[i - 1].second, alternatives[i - 1].first);
+        }
+      }
+    }
+  }
+}
+
+#endif
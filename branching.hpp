@@ -0,0 +1,155 @@
+#ifndef COM_MASAERS_BRANCHING_HPP
+#define COM_MASAERS_BRANCHING_HPP
+#include "sudoku.hpp"
+#include <utility>
+
+namespace com_masaers {
+  // Branching policies decide which alternatives depth first search
+  // branches on in a node. Each policy writes the alternatives as
+  // (position, value) pairs to out, and returns the end of what it
+  // wrote. The alternatives must be mutually exclusive and cover
+  // every solution of the board, and there are never more than N of
+  // them. Nothing is written for solved boards.
+
+  /**
+     Branches on every value of the first unsolved cell.
+   */
+  struct first_cell_branching {
+    template<typename Layout, typename OutputIter>
+    static OutputIter select(const sudoku_board<Layout>& board, OutputIter out);
+  }; // first_cell_branching
+
+  /**
+     Branches on every value of the unsolved cell with the fewest
+     remaining values (minimum remaining values).
+   */
+  struct mrv_branching {
+    template<typename Layout, typename OutputIter>
+    static OutputIter select(const sudoku_board<Layout>& board, OutputIter out);
+  }; // mrv_branching
+
+  /**
+     Like mrv_branching, but breaks ties in favour of the cell with the
+     most unsolved peers, which constrains the most other cells.
+   */
+  struct mrv_degree_branching {
+    template<typename Layout, typename OutputIter>
+    static OutputIter select(const sudoku_board<Layout>& board, OutputIter out);
+  }; // mrv_degree_branching
+
+  /**
+     Branches on the positions a value can take within a row, column
+     or house, picking the value and unit with the fewest positions.
+     A value with no position left in some unit ends the branch.
+   */
+  struct hidden_candidate_branching {
+    template<typename Layout, typename OutputIter>
+    static OutputIter select(const sudoku_board<Layout>& board, OutputIter out);
+  }; // hidden_candidate_branching
+
+  template<typename Layout, typename OutputIter>
+  OutputIter branch_on_cell(const sudoku_board<Layout>& board, const int pos, OutputIter out);
+} // namespace com_masaers
+
+
+// Writes every remaining value of the cell at pos to out.
+template<typename Layout, typename OutputIter>
+inline OutputIter com_masaers::branch_on_cell(const sudoku_board<Layout>& board, const int pos, OutputIter out) {
+  if (pos != -1) {
+    const typename Layout::cell_type& cell = board[pos];
+    for (int value = cell.first(); value < Layout::N; value = cell.next(value)) {
+      *out = std::make_pair(pos, value);
+      ++out;
+    }
+  }
+  return out;
+}
+
+template<typename Layout, typename OutputIter>
+inline OutputIter com_masaers::first_cell_branching::select(const sudoku_board<Layout>& board, OutputIter out) {
+  int best = -1;
+  for (int pos = 0; best == -1 && pos < Layout::NN; ++pos) {
+    if (! board.solved(pos)) {
+      best = pos;
+    }
+  }
+  return branch_on_cell(board, best, out);
+}
+
+template<typename Layout, typename OutputIter>
+inline OutputIter com_masaers::mrv_branching::select(const sudoku_board<Layout>& board, OutputIter out) {
+  int best = -1;
+  std::size_t best_count = Layout::N + 1;
+  for (int pos = 0; best_count > 2 && pos < Layout::NN; ++pos) {
+    const std::size_t count = board[pos].count();
+    if (count > 1 && count < best_count) {
+      best = pos;
+      best_count = count;
+    }
+  }
+  return branch_on_cell(board, best, out);
+}
+
+template<typename Layout, typename OutputIter>
+inline OutputIter com_masaers::mrv_degree_branching::select(const sudoku_board<Layout>& board, OutputIter out) {
+  int best = -1;
+  std::size_t best_count = Layout::N + 1;
+  int best_degree = -1;
+  for (int pos = 0; pos < Layout::NN; ++pos) {
+    const std::size_t count = board[pos].count();
+    if (count > 1 && count <= best_count) {
+      int degree = 0;
+      for (auto it = Layout::first_peer(pos); it != Layout::last_peer(pos); ++it) {
+        if (! board.solved(*it)) {
+          ++degree;
+        }
+      }
+      if (count < best_count || degree > best_degree) {
+        best = pos;
+        best_count = count;
+        best_degree = degree;
+      }
+    }
+  }
+  return branch_on_cell(board, best, out);
+}
+
+template<typename Layout, typename OutputIter>
+inline OutputIter com_masaers::hidden_candidate_branching::select(const sudoku_board<Layout>& board, OutputIter out) {
+  int best_unit = -1;
+  int best_value = -1;
+  int best_count = Layout::N + 1;
+  for (int u = 0; best_count > 1 && u < Layout::UNITS; ++u) {
+    int counts[Layout::N] = { 0 };
+    typename Layout::cell_type placed;
+    for (int i = 0; i < Layout::N; ++i) {
+      const typename Layout::cell_type& cell = board[Layout::pos_of_unit(u, i)];
+      if (board.solved(cell)) {
+        placed |= cell;
+      } else {
+        for (int value = cell.first(); value < Layout::N; value = cell.next(value)) {
+          ++counts[value];
+        }
+      }
+    }
+    for (int value = 0; value < Layout::N; ++value) {
+      if (! placed[value] && counts[value] < best_count) {
+        best_unit = u;
+        best_value = value;
+        best_count = counts[value];
+      }
+    }
+  }
+  if (best_count != 0 && best_unit != -1) {
+    for (int i = 0; i < Layout::N; ++i) {
+      const int pos = Layout::pos_of_unit(best_unit, i);
+      if (! board.solved(pos) && board[pos][best_value]) {
+        *out = std::make_pair(pos, best_value);
+        ++out;
+      }
+    }
+  }
+  return out;
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef COM_MASAERS_CACHE_HPP
+#define COM_MASAERS_CACHE_HPP
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace com_masaers {
+  /**
+     A map of bounded size that drops its least recently used entries
+     to make room for new ones, and that any number of threads can use
+     at once. Keys are spread over SHARDS shards by their hash, and
+     every shard has its own lock and its own share of the capacity,
+     so that threads only contend for keys in the same shard.
+   */
+  template<typename Key, typename Value, typename Hash = std::hash<Key> >
+  class lru_cache {
+  public:
+    static constexpr std::size_t SHARDS = 16;
+    explicit lru_cache(const std::size_t capacity);
+    lru_cache(const lru_cache&) = delete;
+    lru_cache& operator=(const lru_cache&) = delete;
+    // Copies the value of key to value, and makes it the most recently
+    // used entry. Returns false if there is no such key.
+    bool find(const Key& key, Value& value);
+    // Sets the value of key, dropping the least recently used entry of
+    // its shard if that is full.
+    void insert(const Key& key, const Value& value);
+    std::size_t capacity() const { return shard_capacity_m * SHARDS; }
+    std::size_t hits() const { return hits_m.load(); }
+    std::size_t misses() const { return misses_m.load(); }
+  protected:
+    typedef std::list<std::pair<Key, Value> > entries_type;
+    struct shard_type {
+      std::mutex mutex;
+      // Most recently used first.
+      entries_type entries;
+      std::unordered_map<Key, typename entries_type::iterator, Hash> index;
+    };
+    shard_type& shard(const Key& key);
+  private:
+    std::size_t shard_capacity_m;
+    Hash hash_m;
+    std::vector<shard_type> shards_m;
+    std::atomic<std::size_t> hits_m;
+    std::atomic<std::size_t> misses_m;
+  }; // lru_cache
+} // namespace com_masaers
+
+
+template<typename Key, typename Value, typename Hash>
+com_masaers::lru_cache<Key, Value, Hash>::lru_cache(const std::size_t capacity)
+  : shard_capacity_m(capacity == 0 ? 1 : (capacity + SHARDS - 1) / SHARDS)
+  , shards_m(SHARDS)
+  , hits_m(0)
+  , misses_m(0)
+{
+  for (shard_type& shard : shards_m) {
+    shard.index.reserve(shard_capacity_m);
+  }
+}
+
+template<typename Key, typename Value, typename Hash>
+bool com_masaers::lru_cache<Key, Value, Hash>::find(const Key& key, Value& value) {
+  shard_type& s = shard(key);
+  bool result = false;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const auto it = s.index.find(key);
+    if (it != s.index.end()) {
+      s.entries.splice(s.entries.begin(), s.entries, it->second);
+      value = it->second->second;
+      result = true;
+    }
+  }
+  ++(result ? hits_m : misses_m);
+  return result;
+}
+
+template<typename Key, typename Value, typename Hash>
+void com_masaers::lru_cache<Key, Value, Hash>::insert(const Key& key, const Value& value) {
+  shard_type& s = shard(key);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  const auto it = s.index.find(key);
+  if (it != s.index.end()) {
+    it->second->second = value;
+    s.entries.splice(s.entries.begin(), s.entries, it->second);
+  } else {
+    if (s.index.size() >= shard_capacity_m) {
+      // Reuse the node of the dropped entry.
+      s.index.erase(s.entries.back().first);
+      s.entries.splice(s.entries.begin(), s.entries, std::prev(s.entries.end()));
+      s.entries.front().first = key;
+      s.entries.front().second = value;
+    } else {
+      s.entries.emplace_front(key, value);
+    }
+    s.index.emplace(key, s.entries.begin());
+  }
+}
+
+// The shard of a key, taken from the high bits of its hash, since the
+// low ones pick the bucket within the shard.
+template<typename Key, typename Value, typename Hash>
+typename com_masaers::lru_cache<Key, Value, Hash>::shard_type&
+com_masaers::lru_cache<Key, Value, Hash>::shard(const Key& key) {
+  const std::uint64_t mixed = static_cast<std::uint64_t>(hash_m(key)) * 0x9e3779b97f4a7c15ull;
+  return shards_m[(mixed >> 32) % SHARDS];
+}
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef COM_MASAERS_CANONICAL_HPP
+#define COM_MASAERS_CANONICAL_HPP
+#include "sudoku.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace com_masaers {
+  // A 9x9 board in the compact one-line format, as a fixed-size value
+  // that can key a map.
+  typedef std::array<char, 81> sudoku_line;
+
+  struct sudoku_line_hash {
+    std::size_t operator()(const sudoku_line& line) const {
+      return std::hash<std::string_view>()(std::string_view(line.data(), line.size()));
+    }
+  }; // sudoku_line_hash
+
+  /**
+     One of the transformations that take a 9x9 sudoku to an equivalent
+     one: an optional transposition, followed by a permutation of the
+     rows that keeps every band together, one of the columns that keeps
+     every stack together, and a relabeling of the values.
+   */
+  struct sudoku_symmetry {
+    typedef sudoku_board<sudoku_layout<3> > board_type;
+    bool transpose;
+    // Row r of the transformed board is row rows[r] of the (transposed)
+    // original, and the same goes for the columns.
+    unsigned char rows[9];
+    unsigned char cols[9];
+    // Value v, counted from 0, becomes values[v].
+    unsigned char values[9];
+    // The position in the original board of a position in the
+    // transformed one.
+    int source(const int pos) const;
+    // Writes the transformed board, with '.' for cells that are not
+    // solved.
+    void apply(const board_type& board, sudoku_line& line) const;
+    // Reads the original of a transformed board into board.
+    bool invert(const sudoku_line& line, board_type& board) const;
+  }; // sudoku_symmetry
+
+  /**
+     Finds the canonical form of 9x9 puzzles: of every board that a
+     puzzle is taken to by the symmetries, the one that comes first in
+     the compact format once its values are numbered in order of first
+     appearance, with blanks after all values. Puzzles that are
+     relabelings, transpositions or row and column permutations of each
+     other have the same form.
+
+     The form is built a row at a time, keeping every partial symmetry
+     that gives the smallest rows so far. Putting blanks last makes the
+     first row the one with the most givens, which leaves far fewer
+     column orders to choose from than the empty rows that most
+     puzzles have. Puzzles with very few givens, with a lot of
+     symmetry, or with nearly all of them (where a full first row
+     leaves every column order within the stacks open, for each of the
+     rows and columns that tie for first) can keep more than
+     MAX_CANDIDATES of them. The rest are dropped, so that such puzzles
+     may get forms that their equivalents do not share, and finding
+     their forms is slow; batch_solver does not look up puzzles with
+     few blanks for that reason. The form is still a transformation of
+     the puzzle, and anything found out about it holds for the puzzle.
+   */
+  class sudoku_canonicalizer {
+  public:
+    static constexpr std::size_t MAX_CANDIDATES = 1 << 11;
+    // What a blank is in the forms of rows, after every label.
+    static constexpr unsigned char BLANK = 10;
+    // Writes the canonical form of board to line, and returns the
+    // symmetry that takes board there.
+    const sudoku_symmetry& operator()(const sudoku_board<sudoku_layout<3> >& board, sudoku_line& line);
+  protected:
+    // A symmetry that is known for the rows before the current one.
+    struct candidate_type {
+      unsigned char transpose;
+      unsigned char rows[9];
+      unsigned char cols[9];
+      // The label of every value, counted from 1 (as is the value),
+      // or 0 if the value has not been met yet.
+      unsigned char labels[10];
+      unsigned char next_label;
+      // The bands that rows have been taken from.
+      unsigned char bands;
+    };
+    void first_row(const int transpose, const int row, const unsigned char* cells, const int* counts);
+    bool next_row(candidate_type& candidate, const int i, const int row, unsigned char* best, bool& have);
+  private:
+    unsigned char grids_m[2][81];
+    std::vector<candidate_type> candidates_m;
+    std::vector<candidate_type> next_m;
+    sudoku_symmetry symmetry_m;
+  }; // sudoku_canonicalizer
+} // namespace com_masaers
+
+
+inline int com_masaers::sudoku_symmetry::source(const int pos) const {
+  const int row = rows[pos / 9];
+  const int col = cols[pos % 9];
+  return transpose ? col * 9 + row : row * 9 + col;
+}
+
+inline void com_masaers::sudoku_symmetry::apply(const board_type& board, sudoku_line& line) const {
+  for (int pos = 0; pos < 81; ++pos) {
+    const board_type::cell_type& cell = board[source(pos)];
+    line[pos] = cell.single() ? sudoku_symbols<9>::symbol_of(values[cell.first()]) : '.';
+  }
+}
+
+inline bool com_masaers::sudoku_symmetry::invert(const sudoku_line& line, board_type& board) const {
+  unsigned char inverse[9];
+  for (int value = 0; value < 9; ++value) {
+    inverse[values[value]] = value;
+  }
+  char original[81];
+  for (int pos = 0; pos < 81; ++pos) {
+    const int value = sudoku_symbols<9>::value_of(line[pos]);
+    original[source(pos)] = value >= 0 && value < 9 ? sudoku_symbols<9>::symbol_of(inverse[value]) : '.';
+  }
+  return board.read_line(original, original + 81);
+}
+
+inline const com_masaers::sudoku_symmetry&
+com_masaers::sudoku_canonicalizer::operator()(const sudoku_board<sudoku_layout<3> >& board, sudoku_line& line) {
+  for (int pos = 0; pos < 81; ++pos) {
+    const unsigned char value = board[pos].single() ? board[pos].first() + 1 : 0;
+    grids_m[0][pos] = value;
+    grids_m[1][(pos % 9) * 9 + pos / 9] = value;
+  }
+  // The first row only depends on where its givens go, since they all
+  // get new labels: givens first within every stack, and the stacks
+  // with the most givens first.
+  unsigned char best[9];
+  bool have = false;
+  candidates_m.clear();
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    for (int row = 0; row < 9; ++row) {
+      const unsigned char* cells = grids_m[transpose] + row * 9;
+      int counts[3];
+      for (int stack = 0; stack < 3; ++stack) {
+        counts[stack] = (cells[stack * 3] != 0) + (cells[stack * 3 + 1] != 0) + (cells[stack * 3 + 2] != 0);
+      }
+      int sorted[3] = { counts[0], counts[1], counts[2] };
+      std::sort(sorted, sorted + 3, std::greater<int>());
+      unsigned char form[9];
+      unsigned char label = 1;
+      for (int stack = 0; stack < 3; ++stack) {
+        for (int col = 0; col < 3; ++col) {
+          form[stack * 3 + col] = col < sorted[stack] ? label++ : BLANK;
+        }
+      }
+      const int order = have ? std::memcmp(form, best, 9) : -1;
+      if (order < 0) {
+        std::memcpy(best, form, 9);
+        have = true;
+        candidates_m.clear();
+      }
+      if (order <= 0) {
+        first_row(transpose, row, cells, counts);
+      }
+    }
+  }
+  for (int col = 0; col < 9; ++col) {
+    line[col] = best[col] == BLANK ? '.' : sudoku_symbols<9>::symbol_of(best[col] - 1);
+  }
+  for (int i = 1; i < 9; ++i) {
+    have = false;
+    next_m.clear();
+    for (const candidate_type& candidate : candidates_m) {
+      const int slot = i % 3;
+      for (int band = 0; band < 3; ++band) {
+        if (slot == 0 ? (candidate.bands >> band & 1) != 0 : band != candidate.rows[i - 1] / 3) {
+          continue;
+        }
+        for (int row = band * 3; row < band * 3 + 3; ++row) {
+          bool used = false;
+          for (int j = i - slot; j < i; ++j) {
+            used = used || candidate.rows[j] == row;
+          }
+          if (! used) {
+            candidate_type extended = candidate;
+            if (next_row(extended, i, row, best, have) && next_m.size() < MAX_CANDIDATES) {
+              next_m.push_back(extended);
+            }
+          }
+        }
+      }
+    }
+    candidates_m.swap(next_m);
+    for (int col = 0; col < 9; ++col) {
+      line[i * 9 + col] = best[col] == BLANK ? '.' : sudoku_symbols<9>::symbol_of(best[col] - 1);
+    }
+  }
+  // Values that the puzzle does not have take the labels left over.
+  candidate_type& chosen = candidates_m.front();
+  symmetry_m.transpose = chosen.transpose != 0;
+  std::memcpy(symmetry_m.rows, chosen.rows, 9);
+  std::memcpy(symmetry_m.cols, chosen.cols, 9);
+  for (int value = 1; value <= 9; ++value) {
+    if (chosen.labels[value] == 0) {
+      chosen.labels[value] = chosen.next_label++;
+    }
+    symmetry_m.values[value - 1] = chosen.labels[value] - 1;
+  }
+  return symmetry_m;
+}
+
+// Adds a candidate for every column order that puts the givens of the
+// first row where they give its smallest form.
+inline void com_masaers::sudoku_canonicalizer::first_row(const int transpose, const int row, const unsigned char* cells, const int* counts) {
+  static const unsigned char PERMUTATIONS[6][3] = { {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0} };
+  // The orders within every stack that put its givens first.
+  int orders[3][6];
+  int order_counts[3] = {};
+  for (int stack = 0; stack < 3; ++stack) {
+    for (int p = 0; p < 6; ++p) {
+      const unsigned char* perm = PERMUTATIONS[p];
+      const bool given[3] = { cells[stack * 3 + perm[0]] != 0, cells[stack * 3 + perm[1]] != 0, cells[stack * 3 + perm[2]] != 0 };
+      if (given[0] >= given[1] && given[1] >= given[2]) {
+        orders[stack][order_counts[stack]++] = p;
+      }
+    }
+  }
+  for (int s = 0; s < 6; ++s) {
+    const unsigned char* stacks = PERMUTATIONS[s];
+    if (counts[stacks[0]] < counts[stacks[1]] || counts[stacks[1]] < counts[stacks[2]]) {
+      continue;
+    }
+    for (int a = 0; a < order_counts[stacks[0]]; ++a) {
+      for (int b = 0; b < order_counts[stacks[1]]; ++b) {
+        for (int c = 0; c < order_counts[stacks[2]] && candidates_m.size() < MAX_CANDIDATES; ++c) {
+          const int within[3] = { orders[stacks[0]][a], orders[stacks[1]][b], orders[stacks[2]][c] };
+          candidate_type candidate;
+          candidate.transpose = transpose;
+          candidate.rows[0] = row;
+          std::memset(candidate.labels, 0, sizeof(candidate.labels));
+          candidate.next_label = 1;
+          candidate.bands = 1 << (row / 3);
+          for (int stack = 0; stack < 3; ++stack) {
+            for (int col = 0; col < 3; ++col) {
+              const int source = stacks[stack] * 3 + PERMUTATIONS[within[stack]][col];
+              candidate.cols[stack * 3 + col] = source;
+              const unsigned char value = cells[source];
+              if (value != 0) {
+                candidate.labels[value] = candidate.next_label++;
+              }
+            }
+          }
+          candidates_m.push_back(candidate);
+        }
+      }
+    }
+  }
+}
+
+// Takes row as the ith row of a candidate, and compares the form that
+// it gets with the best one so far. Returns false if it is worse, and
+// otherwise makes it the best (dropping the candidates kept so far if
+// it is strictly better).
+inline bool com_masaers::sudoku_canonicalizer::next_row(candidate_type& candidate, const int i, const int row, unsigned char* best, bool& have) {
+  const unsigned char* cells = grids_m[candidate.transpose] + row * 9;
+  unsigned char form[9];
+  int order = have ? 0 : -1;
+  for (int col = 0; col < 9; ++col) {
+    const unsigned char value = cells[candidate.cols[col]];
+    if (value != 0 && candidate.labels[value] == 0) {
+      candidate.labels[value] = candidate.next_label++;
+    }
+    form[col] = value == 0 ? BLANK : candidate.labels[value];
+    if (order == 0) {
+      if (form[col] > best[col]) {
+        return false;
+      }
+      order = form[col] < best[col] ? -1 : 0;
+    }
+  }
+  if (order < 0) {
+    std::memcpy(best, form, 9);
+    have = true;
+    next_m.clear();
+  }
+  candidate.rows[i] = row;
+  candidate.bands |= 1 << (row / 3);
+  return true;
+}
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef COM_MASAERS_CELL_HPP
+#define COM_MASAERS_CELL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+namespace com_masaers {
+  /**
+     The smallest unsigned integer that holds N bits, or 64 bits for
+     larger N, in which case the cell uses several words.
+   */
+  template<int N>
+  struct sudoku_cell_word {
+    typedef typename std::conditional<N <= 16, std::uint16_t,
+            typename std::conditional<N <= 32, std::uint32_t,
+                                               std::uint64_t>::type>::type type;
+  }; // sudoku_cell_word
+
+  // Bit twiddling on single words, mapped to compiler intrinsics
+  // (which become single instructions where the target has them).
+  // Everything here is constexpr, so that layouts can build their
+  // position masks at compile time.
+  constexpr int popcount_word(const std::uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int result = 0;
+    for (std::uint64_t y = x; y != 0; y &= y - 1) { ++result; }
+    return result;
+#endif
+  }
+  // Index of the lowest set bit; x must not be zero.
+  constexpr int lowest_bit_word(const std::uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int result = 0;
+    while (((x >> result) & 1) == 0) { ++result; }
+    return result;
+#endif
+  }
+
+  /**
+     The set of values that a cell can still take, as a fixed-width
+     bit set of N bits. Boards up to 16x16 fit a cell in a single
+     16-bit word; larger boards use 32 or 64-bit words, or an array of
+     64-bit words beyond 64 values.
+
+     The interface follows std::bitset (which this replaces), with
+     single() and first()/next() added for the operations that the
+     solvers need most.
+   */
+  template<int N>
+  class sudoku_cell {
+  public:
+    typedef typename sudoku_cell_word<N>::type word_type;
+    static constexpr int WORD_BITS = sizeof(word_type) * 8;
+    static constexpr int WORDS = (N + WORD_BITS - 1) / WORD_BITS;
+    constexpr sudoku_cell() : words_m() {}
+    static constexpr std::size_t size() { return N; }
+    // Sets every one of the N bits.
+    constexpr sudoku_cell& set();
+    constexpr sudoku_cell& set(const int i) { words_m[i / WORD_BITS] |= bit(i); return *this; }
+    constexpr sudoku_cell& reset();
+    constexpr sudoku_cell& reset(const int i) { words_m[i / WORD_BITS] &= ~bit(i); return *this; }
+    constexpr sudoku_cell& flip(const int i) { words_m[i / WORD_BITS] ^= bit(i); return *this; }
+    constexpr bool test(const int i) const { return (words_m[i / WORD_BITS] & bit(i)) != 0; }
+    constexpr bool operator[](const int i) const { return test(i); }
+    constexpr std::size_t count() const;
+    constexpr bool none() const;
+    constexpr bool any() const { return ! none(); }
+    // Whether exactly one bit is set.
+    constexpr bool single() const;
+    // The lowest set bit, or N if there is none.
+    constexpr int first() const;
+    // The lowest set bit above i, or N if there is none.
+    constexpr int next(const int i) const;
+    // The raw bits of a single word cell.
+    constexpr word_type word(const int w = 0) const { return words_m[w]; }
+    constexpr sudoku_cell& operator&=(const sudoku_cell& x);
+    constexpr sudoku_cell& operator|=(const sudoku_cell& x);
+    constexpr sudoku_cell& operator^=(const sudoku_cell& x);
+    constexpr sudoku_cell operator~() const;
+    constexpr sudoku_cell operator&(const sudoku_cell& x) const { sudoku_cell result(*this); return result &= x; }
+    constexpr sudoku_cell operator|(const sudoku_cell& x) const { sudoku_cell result(*this); return result |= x; }
+    constexpr sudoku_cell operator^(const sudoku_cell& x) const { sudoku_cell result(*this); return result ^= x; }
+    constexpr bool operator==(const sudoku_cell& x) const;
+    constexpr bool operator!=(const sudoku_cell& x) const { return ! operator==(x); }
+    constexpr std::size_t hash() const;
+  protected:
+    static constexpr word_type bit(const int i) { return word_type(1) << (i % WORD_BITS); }
+    // The bits of the last word that belong to the cell.
+    static constexpr word_type last_mask() {
+      return N % WORD_BITS == 0 ? word_type(~word_type(0)) : word_type((word_type(1) << (N % WORD_BITS)) - 1);
+    }
+  private:
+    word_type words_m[WORDS];
+  }; // sudoku_cell
+} // namespace com_masaers
+
+namespace std {
+  template<int N>
+  struct hash<com_masaers::sudoku_cell<N> > {
+    std::size_t operator()(const com_masaers::sudoku_cell<N>& cell) const { return cell.hash(); }
+  };
+} // namespace std
+
+
+template<int N>
+constexpr com_masaers::sudoku_cell<N>& com_masaers::sudoku_cell<N>::set() {
+  for (int w = 0; w < WORDS - 1; ++w) {
+    words_m[w] = word_type(~word_type(0));
+  }
+  words_m[WORDS - 1] = last_mask();
+  return *this;
+}
+
+template<int N>
+constexpr com_masaers::sudoku_cell<N>& com_masaers::sudoku_cell<N>::reset() {
+  for (int w = 0; w < WORDS; ++w) {
+    words_m[w] = 0;
+  }
+  return *this;
+}
+
+template<int N>
+constexpr std::size_t com_masaers::sudoku_cell<N>::count() const {
+  std::size_t result = 0;
+  for (int w = 0; w < WORDS; ++w) {
+    result += popcount_word(words_m[w]);
+  }
+  return result;
+}
+
+template<int N>
+constexpr bool com_masaers::sudoku_cell<N>::none() const {
+  bool result = true;
+  for (int w = 0; result && w < WORDS; ++w) {
+    result = words_m[w] == 0;
+  }
+  return result;
+}
+
+template<int N>
+constexpr bool com_masaers::sudoku_cell<N>::single() const {
+  int bits = 0;
+  for (int w = 0; bits < 2 && w < WORDS; ++w) {
+    const word_type x = words_m[w];
+    if (x != 0) {
+      bits += (x & (x - 1)) == 0 ? 1 : 2;
+    }
+  }
+  return bits == 1;
+}
+
+template<int N>
+constexpr int com_masaers::sudoku_cell<N>::first() const {
+  for (int w = 0; w < WORDS; ++w) {
+    if (words_m[w] != 0) {
+      return w * WORD_BITS + lowest_bit_word(words_m[w]);
+    }
+  }
+  return N;
+}
+
+template<int N>
+constexpr int com_masaers::sudoku_cell<N>::next(const int i) const {
+  const int start = i + 1;
+  if (start >= N) {
+    return N;
+  }
+  int w = start / WORD_BITS;
+  word_type x = words_m[w] & word_type(word_type(~word_type(0)) << (start % WORD_BITS));
+  while (x == 0) {
+    if (++w == WORDS) {
+      return N;
+    }
+    x = words_m[w];
+  }
+  return w * WORD_BITS + lowest_bit_word(x);
+}
+
+template<int N>
+constexpr com_masaers::sudoku_cell<N>& com_masaers::sudoku_cell<N>::operator&=(const sudoku_cell& x) {
+  for (int w = 0; w < WORDS; ++w) {
+    words_m[w] &= x.words_m[w];
+  }
+  return *this;
+}
+
+template<int N>
+constexpr com_masaers::sudoku_cell<N>& com_masaers::sudoku_cell<N>::operator|=(const sudoku_cell& x) {
+  for (int w = 0; w < WORDS; ++w) {
+    words_m[w] |= x.words_m[w];
+  }
+  return *this;
+}
+
+template<int N>
+constexpr com_masaers::sudoku_cell<N>& com_masaers::sudoku_cell<N>::operator^=(const sudoku_cell& x) {
+  for (int w = 0; w < WORDS; ++w) {
+    words_m[w] ^= x.words_m[w];
+  }
+  return *this;
+}
+
+template<int N>
+constexpr com_masaers::sudoku_cell<N> com_masaers::sudoku_cell<N>::operator~() const {
+  sudoku_cell result;
+  for (int w = 0; w < WORDS; ++w) {
+    result.words_m[w] = word_type(~words_m[w]);
+  }
+  result.words_m[WORDS - 1] &= last_mask();
+  return result;
+}
+
+template<int N>
+constexpr bool com_masaers::sudoku_cell<N>::operator==(const sudoku_cell& x) const {
+  bool result = true;
+  for (int w = 0; result && w < WORDS; ++w) {
+    result = words_m[w] == x.words_m[w];
+  }
+  return result;
+}
+
+template<int N>
+constexpr std::size_t com_masaers::sudoku_cell<N>::hash() const {
+  std::size_t result = 0;
+  for (int w = 0; w < WORDS; ++w) {
+    result = result * 0x9e3779b97f4a7c15ull + words_m[w];
+  }
+  return result;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include "sudoku.hpp"
+#include "input.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+// Regression cases for what the binaries cannot be run on by the test
+// target. Every case writes one line saying whether it held, and the
+// exit status is non-zero if any of them did not.
+
+// Reads text as a board in the grid format, and checks whether that
+// is expected to work, and where the reading stopped.
+template<typename Layout>
+bool read_grid_case(const std::string& text, const bool expected, const std::size_t stop) {
+  using namespace com_masaers;
+  sudoku_board<Layout> board;
+  const char* first = text.data();
+  const bool result = board.read_grid(first, text.data() + text.size());
+  return result == expected && std::size_t(first - text.data()) == stop;
+}
+
+// A grid of the numbers 1 to N, with value in place of the number at
+// pos.
+template<typename Layout>
+std::string grid_with(const int pos, const std::string& value) {
+  std::string result;
+  for (int i = 0; i < Layout::NN; ++i) {
+    result += i == pos ? value : std::to_string(1 + i % Layout::N);
+    result += i % Layout::N == Layout::N - 1 ? '\n' : ' ';
+  }
+  return result;
+}
+
+// Reads text as a file of grid format boards, and checks the status
+// of the first one.
+template<typename Layout>
+bool next_grid_case(const std::string& text, const com_masaers::puzzle_reader::status_type expected) {
+  using namespace com_masaers;
+  char path[] = "/tmp/checkXXXXXX";
+  const int fd = mkstemp(path);
+  bool result = fd >= 0 && write(fd, text.data(), text.size()) == ssize_t(text.size());
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (result) {
+    puzzle_reader in(path);
+    sudoku_board<Layout> board;
+    result = in.next_grid(board) == expected;
+  }
+  std::remove(path);
+  return result;
+}
+
+int main(const int argc, const char** argv) {
+  using namespace std;
+  using namespace com_masaers;
+  typedef sudoku_layout<3> layout9;
+  typedef sudoku_layout<2> layout4;
+  int failed = 0;
+  auto check = [&](const char* name, const bool held) {
+    cout << name << ": " << (held ? "ok" : "FAILED") << endl;
+    failed += ! held;
+  };
+  const string nine = grid_with<layout9>(-1, "");
+  check("read_grid reads a full 9x9 grid", read_grid_case<layout9>(nine, true, nine.size() - 1));
+  check("read_grid rejects 10 on a 9x9 board", read_grid_case<layout9>("10", false, 0));
+  check("read_grid rejects 99 on a 9x9 board", read_grid_case<layout9>("99", false, 0));
+  check("read_grid rejects 10 in the last cell", read_grid_case<layout9>(grid_with<layout9>(80, "10"), false, nine.size() - 2));
+  check("read_grid rejects 5 on a 4x4 board", read_grid_case<layout4>(grid_with<layout4>(3, "5"), false, 6));
+  check("next_grid rejects 99", next_grid_case<layout9>("99\n", puzzle_reader::malformed));
+  check("next_grid ends on blank input", next_grid_case<layout9>(" \n\n", puzzle_reader::end));
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,357 @@
+#ifndef COM_MASAERS_DLX_HPP
+#define COM_MASAERS_DLX_HPP
+#include "sudoku.hpp"
+#include <iterator>
+#include <vector>
+
+namespace com_masaers {
+  /**
+     Solves boards as exact cover problems with Knuth's dancing links
+     (Algorithm X). Every (position, value) pair is a row that covers
+     four columns: its cell, and its value in its row, column and
+     house. A solution is a set of rows that covers every column
+     exactly once.
+
+     The whole matrix lives in one contiguous arena of nodes linked by
+     index, built once per solver. A board is loaded by hiding the rows
+     of values its cells can no longer take and selecting the rows of
+     its solved cells, and unloaded by undoing both in reverse order,
+     so the arena is never rebuilt between boards.
+
+     Has the same interface as depth_first_solver.
+   */
+  template<typename Layout>
+  class dlx_solver {
+  public:
+    dlx_solver();
+    const sudoku_board<Layout>& operator()(const sudoku_board<Layout>& board);
+    const std::vector<sudoku_board<Layout> >& operator()(const sudoku_board<Layout>& board, std::size_t solutions);
+    // The number of rows tried by the last search.
+    std::size_t nodes() const { return tried_m; }
+  protected:
+    static constexpr int COLUMNS = 4 * Layout::NN;
+    static constexpr int ROWS = Layout::N * Layout::NN;
+    // The root is node 0, the column headers are nodes 1 to COLUMNS,
+    // and row r is the four nodes from FIRST_ROW_NODE + 4r on.
+    static constexpr int FIRST_ROW_NODE = COLUMNS + 1;
+    struct node_type {
+      int left;
+      int right;
+      int up;
+      int down;
+      int column;
+    }; // node_type
+    static int row_of_node(const int node) { return (node - FIRST_ROW_NODE) / 4; }
+    void cover(const int column);
+    void uncover(const int column);
+    void hide(const int row);
+    void unhide(const int row);
+    bool available(const int row) const;
+    void cover_others(const int node);
+    void uncover_others(const int node);
+    void select(const int node);
+    void deselect(const int node);
+    int choose_column() const;
+    bool load(const sudoku_board<Layout>& board);
+    void unload();
+    void search(const sudoku_board<Layout>& board, std::size_t solutions);
+    void store(const sudoku_board<Layout>& board);
+  private:
+    std::vector<node_type> nodes_m;
+    std::vector<int> sizes_m;
+    std::vector<int> hidden_m;
+    std::vector<int> givens_m;
+    std::vector<int> choices_m;
+    std::vector<int> solved_m;
+    std::vector<sudoku_board<Layout> > solutions_m;
+    std::size_t tried_m = 0;
+  }; // dlx_solver
+} // namespace com_masaers
+
+
+template<typename Layout>
+com_masaers::dlx_solver<Layout>::dlx_solver()
+  : nodes_m(FIRST_ROW_NODE + 4 * ROWS)
+  , sizes_m(COLUMNS + 1, 0)
+{
+  for (int c = 0; c <= COLUMNS; ++c) {
+    node_type& header = nodes_m[c];
+    header.left = c == 0 ? COLUMNS : c - 1;
+    header.right = c == COLUMNS ? 0 : c + 1;
+    header.up = header.down = header.column = c;
+  }
+  for (int pos = 0; pos < Layout::NN; ++pos) {
+    const int row = Layout::row_of_pos(pos);
+    const int col = Layout::col_of_pos(pos);
+    const int house = Layout::house_of_pos(pos);
+    for (int value = 0; value < Layout::N; ++value) {
+      const int columns[4] = {
+        1 + pos,
+        1 + Layout::NN + row * Layout::N + value,
+        1 + 2 * Layout::NN + col * Layout::N + value,
+        1 + 3 * Layout::NN + house * Layout::N + value
+      };
+      const int first = FIRST_ROW_NODE + 4 * (pos * Layout::N + value);
+      for (int i = 0; i < 4; ++i) {
+        node_type& node = nodes_m[first + i];
+        node_type& header = nodes_m[columns[i]];
+        node.left = first + (i + 3) % 4;
+        node.right = first + (i + 1) % 4;
+        node.column = columns[i];
+        node.up = header.up;
+        node.down = columns[i];
+        nodes_m[header.up].down = first + i;
+        header.up = first + i;
+        ++sizes_m[columns[i]];
+      }
+    }
+  }
+  hidden_m.reserve(ROWS);
+  givens_m.reserve(Layout::NN);
+  choices_m.reserve(Layout::NN);
+  solved_m.reserve(Layout::NN);
+}
+
+template<typename Layout>
+inline const com_masaers::sudoku_board<Layout>& com_masaers::dlx_solver<Layout>::operator()(const sudoku_board<Layout>& board) {
+  operator()(board, 1);
+  if (solutions_m.empty()) {
+    return board;
+  } else {
+    return solutions_m.front();
+  }
+}
+
+template<typename Layout>
+const std::vector<com_masaers::sudoku_board<Layout> >& com_masaers::dlx_solver<Layout>::operator()(const sudoku_board<Layout>& board, std::size_t solutions) {
+  solutions_m.clear();
+  tried_m = 0;
+  if (solutions != 0 && load(board)) {
+    search(board, solutions);
+  }
+  unload();
+  return solutions_m;
+}
+
+// Removes a column from the header list, and every row that covers it
+// from the other columns.
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::cover(const int column) {
+  node_type& header = nodes_m[column];
+  nodes_m[header.left].right = header.right;
+  nodes_m[header.right].left = header.left;
+  for (int i = header.down; i != column; i = nodes_m[i].down) {
+    for (int j = nodes_m[i].right; j != i; j = nodes_m[j].right) {
+      const node_type& node = nodes_m[j];
+      nodes_m[node.up].down = node.down;
+      nodes_m[node.down].up = node.up;
+      --sizes_m[node.column];
+    }
+  }
+}
+
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::uncover(const int column) {
+  node_type& header = nodes_m[column];
+  for (int i = header.up; i != column; i = nodes_m[i].up) {
+    for (int j = nodes_m[i].left; j != i; j = nodes_m[j].left) {
+      const node_type& node = nodes_m[j];
+      nodes_m[node.up].down = j;
+      nodes_m[node.down].up = j;
+      ++sizes_m[node.column];
+    }
+  }
+  nodes_m[header.left].right = column;
+  nodes_m[header.right].left = column;
+}
+
+// Removes a row from all of its columns.
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::hide(const int row) {
+  const int first = FIRST_ROW_NODE + 4 * row;
+  for (int j = first; j != first + 4; ++j) {
+    const node_type& node = nodes_m[j];
+    nodes_m[node.up].down = node.down;
+    nodes_m[node.down].up = node.up;
+    --sizes_m[node.column];
+  }
+}
+
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::unhide(const int row) {
+  const int first = FIRST_ROW_NODE + 4 * row;
+  for (int j = first + 3; j >= first; --j) {
+    const node_type& node = nodes_m[j];
+    nodes_m[node.up].down = j;
+    nodes_m[node.down].up = j;
+    ++sizes_m[node.column];
+  }
+}
+
+// Whether a row is still in the matrix. Rows that share a column with
+// a selected row, and hidden rows, are unlinked from at least three
+// of their four columns.
+template<typename Layout>
+inline bool com_masaers::dlx_solver<Layout>::available(const int row) const {
+  bool result = true;
+  const int first = FIRST_ROW_NODE + 4 * row;
+  for (int j = first; result && j != first + 4; ++j) {
+    result = nodes_m[nodes_m[j].up].down == j;
+  }
+  return result;
+}
+
+// Covers the columns of the row of node, except the column of node.
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::cover_others(const int node) {
+  for (int j = nodes_m[node].right; j != node; j = nodes_m[j].right) {
+    cover(nodes_m[j].column);
+  }
+}
+
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::uncover_others(const int node) {
+  for (int j = nodes_m[node].left; j != node; j = nodes_m[j].left) {
+    uncover(nodes_m[j].column);
+  }
+}
+
+// Adds the row of node to the partial solution, covering all of its
+// columns.
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::select(const int node) {
+  cover(nodes_m[node].column);
+  cover_others(node);
+}
+
+template<typename Layout>
+inline void com_masaers::dlx_solver<Layout>::deselect(const int node) {
+  uncover_others(node);
+  uncover(nodes_m[node].column);
+}
+
+// The uncovered column with the fewest rows left, or 0 (the root) if
+// every column is covered.
+template<typename Layout>
+inline int com_masaers::dlx_solver<Layout>::choose_column() const {
+  int result = 0;
+  int best = ROWS + 1;
+  for (int c = nodes_m[0].right; best > 1 && c != 0; c = nodes_m[c].right) {
+    if (sizes_m[c] < best) {
+      result = c;
+      best = sizes_m[c];
+    }
+  }
+  return result;
+}
+
+// Hides the rows of values that the board has ruled out, and selects
+// the rows of its solved cells. Returns false if two solved cells
+// conflict, or a cell has no values left.
+template<typename Layout>
+bool com_masaers::dlx_solver<Layout>::load(const sudoku_board<Layout>& board) {
+  bool result = true;
+  for (int pos = 0; result && pos < Layout::NN; ++pos) {
+    result = board[pos].any();
+    for (int value = 0; result && value < Layout::N; ++value) {
+      if (! board[pos][value]) {
+        hide(pos * Layout::N + value);
+        hidden_m.push_back(pos * Layout::N + value);
+      }
+    }
+  }
+  for (int pos = 0; result && pos < Layout::NN; ++pos) {
+    if (board.solved(pos)) {
+      const int row = pos * Layout::N + board[pos].first();
+      result = available(row);
+      if (result) {
+        select(FIRST_ROW_NODE + 4 * row);
+        givens_m.push_back(FIRST_ROW_NODE + 4 * row);
+      }
+    }
+  }
+  return result;
+}
+
+// Undoes load, leaving the full matrix.
+template<typename Layout>
+void com_masaers::dlx_solver<Layout>::unload() {
+  while (! givens_m.empty()) {
+    deselect(givens_m.back());
+    givens_m.pop_back();
+  }
+  while (! hidden_m.empty()) {
+    unhide(hidden_m.back());
+    hidden_m.pop_back();
+  }
+}
+
+// Algorithm X, iteratively: choices_m holds the node of the row tried
+// at every level. The column of a level stays covered while its rows
+// are tried, and a level whose column has run out of rows pops back
+// to the level before.
+template<typename Layout>
+void com_masaers::dlx_solver<Layout>::search(const sudoku_board<Layout>& board, std::size_t solutions) {
+  choices_m.clear();
+  bool advance = true;
+  while (true) {
+    if (advance) {
+      const int column = choose_column();
+      if (column == 0) {
+        store(board);
+        if (solutions_m.size() >= solutions) {
+          break;
+        }
+      } else {
+        cover(column);
+        const int node = nodes_m[column].down;
+        if (node != column) {
+          choices_m.push_back(node);
+          cover_others(node);
+          ++tried_m;
+          continue;
+        }
+        uncover(column);
+      }
+    }
+    // Backtrack to the next row of the deepest column with rows left.
+    advance = false;
+    while (! advance && ! choices_m.empty()) {
+      const int node = choices_m.back();
+      uncover_others(node);
+      const int next = nodes_m[node].down;
+      if (next == nodes_m[node].column) {
+        uncover(next);
+        choices_m.pop_back();
+      } else {
+        choices_m.back() = next;
+        cover_others(next);
+        ++tried_m;
+        advance = true;
+      }
+    }
+    if (! advance) {
+      break;
+    }
+  }
+  // Leave the matrix as load left it.
+  while (! choices_m.empty()) {
+    deselect(choices_m.back());
+    choices_m.pop_back();
+  }
+}
+
+// Adds the board with the rows of the current partial solution placed
+// to the solutions.
+template<typename Layout>
+void com_masaers::dlx_solver<Layout>::store(const sudoku_board<Layout>& board) {
+  solutions_m.emplace_back(board);
+  sudoku_board<Layout>& solution = solutions_m.back();
+  for (auto it = choices_m.begin(); it != choices_m.end(); ++it) {
+    const int row = row_of_node(*it);
+    solution.apply_mask(row / Layout::N, sudoku_board<Layout>::make_mask(row % Layout::N), std::back_inserter(solved_m));
+  }
+  solved_m.clear();
+}
+
+#endif
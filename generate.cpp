@@ -0,0 +1,158 @@
+#include "sudoku.hpp"
+#include "bitboard.hpp"
+#include "dlx.hpp"
+#include "generator.hpp"
+#include "pool.hpp"
+#include "timer.hpp"
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Generates puzzles [first, last) of the sequence of a seed, one line
+// per puzzle, into out. Returns the number of puzzles that could not be
+// generated.
+template<typename Layout, typename Generator>
+std::size_t generate_range(Generator& generate, const std::uint64_t seed, const std::uint64_t first, const std::uint64_t last, std::string& out) {
+  using namespace com_masaers;
+  std::size_t result = 0;
+  sudoku_board<Layout> puzzle;
+  for (std::uint64_t index = first; index != last; ++index) {
+    if (generate(seed, index, puzzle)) {
+      puzzle.write_line(std::back_inserter(out));
+      out.push_back('\n');
+    } else {
+      ++result;
+    }
+  }
+  return result;
+}
+
+
+// Generates count puzzles of one layout to stdout, and reports the
+// rate on stderr. Search is the engine that checks for uniqueness.
+template<typename Layout, typename Search>
+bool generate(const std::uint64_t count, const std::uint64_t seed, const int clues, const bool hard, const std::size_t threads) {
+  using namespace std;
+  using namespace com_masaers;
+  typedef puzzle_generator<Layout, Search> generator_type;
+  // Puzzles per task, and tasks per round of output.
+  const uint64_t CHUNK = 64;
+  const uint64_t ROUND = 64;
+
+  if (clues < 0 || clues > Layout::NN) {
+    cerr << "The number of clues must be between 0 and " << Layout::NN << "." << endl;
+    return false;
+  }
+
+  timer generate_time;
+  generate_time.start();
+  size_t failed = 0;
+  if (threads <= 1) {
+    generator_type generate(clues, hard);
+    string out;
+    for (uint64_t first = 0; first < count; first += CHUNK) {
+      out.clear();
+      failed += generate_range<Layout>(generate, seed, first, min(first + CHUNK, count), out);
+      cout << out;
+    }
+  } else {
+    // Every worker has its own generator. Each round is a fixed number
+    // of chunks, written in order once the whole round is done.
+    work_stealing_pool pool(threads);
+    vector<unique_ptr<generator_type> > generators;
+    for (size_t i = 0; i < pool.size(); ++i) {
+      generators.emplace_back(new generator_type(clues, hard));
+    }
+    vector<string> outs(ROUND);
+    vector<size_t> fails(ROUND);
+    for (uint64_t round = 0; round < count; round += CHUNK * ROUND) {
+      for (uint64_t chunk = 0; chunk < ROUND; ++chunk) {
+        const uint64_t first = min(round + chunk * CHUNK, count);
+        const uint64_t last = min(first + CHUNK, count);
+        outs[chunk].clear();
+        pool.submit([&, chunk, first, last](const size_t worker) {
+            fails[chunk] = generate_range<Layout>(*generators[worker], seed, first, last, outs[chunk]);
+          });
+      }
+      pool.wait();
+      for (uint64_t chunk = 0; chunk < ROUND; ++chunk) {
+        cout << outs[chunk];
+        failed += fails[chunk];
+      }
+    }
+  }
+  cout.flush();
+  generate_time.stop();
+
+  const double seconds = generate_time.ns() / 1e9;
+  cerr << "Generated " << (count - failed) << " puzzle(s) in " << generate_time << " s";
+  if (seconds > 0) {
+    cerr << " (" << static_cast<uint64_t>((count - failed) * 60 / seconds) << " puzzles/min)";
+  }
+  cerr << "." << endl;
+  if (failed != 0) {
+    cerr << "Gave up on " << failed << " puzzle(s) after " << generator_type::MAX_ATTEMPTS << " attempts each." << endl;
+  }
+  return failed == 0;
+}
+
+
+int main(const int argc, const char** argv) {
+  using namespace std;
+  using namespace com_masaers;
+
+  uint64_t count = 1;
+  uint64_t seed = 0;
+  int clues = 0;
+  bool hard = false;
+  size_t threads = 1;
+  string layout = "3";
+
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--count=", 8) == 0) {
+      count = strtoull(argv[i] + 8, nullptr, 10);
+    } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+      seed = strtoull(argv[i] + 7, nullptr, 10);
+    } else if (strncmp(argv[i], "--clues=", 8) == 0) {
+      clues = atoi(argv[i] + 8);
+    } else if (strcmp(argv[i], "--hard") == 0) {
+      hard = true;
+    } else if (strncmp(argv[i], "--layout=", 9) == 0) {
+      layout = argv[i] + 9;
+    } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+      threads = strtoul(argv[i] + 10, nullptr, 10);
+      if (threads == 0) {
+        threads = thread::hardware_concurrency();
+      }
+    } else {
+      cerr << "Unknown option: " << argv[i] << "." << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  ios::sync_with_stdio(false);
+  bool ok = true;
+  // The bitboard engine is the fastest on 9x9 boards; the other sizes
+  // check uniqueness with dancing links.
+  if (layout == "3") {
+    ok = generate<sudoku_layout<3>, bitboard_solver>(count, seed, clues, hard, threads);
+  } else if (layout == "3x4") {
+    ok = generate<sudoku_layout<3, 4>, dlx_solver<sudoku_layout<3, 4> > >(count, seed, clues, hard, threads);
+  } else if (layout == "4") {
+    ok = generate<sudoku_layout<4>, dlx_solver<sudoku_layout<4> > >(count, seed, clues, hard, threads);
+  } else if (layout == "5") {
+    ok = generate<sudoku_layout<5>, dlx_solver<sudoku_layout<5> > >(count, seed, clues, hard, threads);
+  } else if (layout == "6") {
+    ok = generate<sudoku_layout<6>, dlx_solver<sudoku_layout<6> > >(count, seed, clues, hard, threads);
+  } else {
+    cerr << "Unknown layout: " << layout << "." << endl;
+    ok = false;
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
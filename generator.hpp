@@ -0,0 +1,200 @@
+#ifndef COM_MASAERS_GENERATOR_HPP
+#define COM_MASAERS_GENERATOR_HPP
+#include "sudoku.hpp"
+#include "solver.hpp"
+#include "pseudoku.hpp"
+#include "dlx.hpp"
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace com_masaers {
+  /**
+     Generates puzzles with exactly one solution. A puzzle starts out
+     as a random solved board, built by solving a board with only its
+     first row given and then shuffling bands, stacks, and the rows and
+     columns within them. Clues are then removed in random order, and
+     every removal that leaves more than one solution is undone, until
+     the puzzle is down to the target number of clues (or, with a
+     target of 0, until no clue can be removed). Boards that cannot
+     reach the target are thrown away and tried again.
+
+     Hard puzzles are those that the deductions of pseudoku_solver
+     cannot solve without search.
+
+     The puzzle with a given index is a function of the seed and the
+     index alone, so a sequence of puzzles can be reproduced however it
+     is split over threads. Random numbers are drawn with plain modulo
+     rather than the standard distributions, whose output differs
+     between standard libraries.
+
+     Search is the engine used to look for solutions. It is given
+     boards straight from digging, without running the trivial solver
+     first (which would double the time spent), so it has to handle
+     boards that are not propagated, as dlx_solver and bitboard_solver
+     do.
+   */
+  template<typename Layout, typename Search = dlx_solver<Layout> >
+  class puzzle_generator {
+  public:
+    typedef std::mt19937_64 random_type;
+    // The number of boards tried for one puzzle before giving up.
+    static constexpr int MAX_ATTEMPTS = 1000;
+    explicit puzzle_generator(const int clues = 0, const bool hard = false);
+    // Generates the puzzle with the given index of the sequence of a
+    // seed. Returns false if no puzzle was found in MAX_ATTEMPTS.
+    bool operator()(const std::uint64_t seed, const std::uint64_t index, sudoku_board<Layout>& puzzle);
+    // The number of boards tried by the last call to operator().
+    int attempts() const { return attempts_m; }
+  protected:
+    void fill(random_type& random, sudoku_board<Layout>& board);
+    void shuffle(random_type& random, sudoku_board<Layout>& board);
+    bool dig(random_type& random, sudoku_board<Layout>& board);
+    bool unsolvable(const sudoku_board<Layout>& board);
+    bool hard(const sudoku_board<Layout>& board);
+    void permute(random_type& random, int* first, const int size);
+  private:
+    int clues_m;
+    bool hard_m;
+    int attempts_m;
+    trivial_solver<Layout> trivial_m;
+    Search search_m;
+    pseudoku_solver<Layout> pseudoku_m;
+    std::vector<int> order_m;
+    std::vector<int> solved_m;
+  }; // puzzle_generator
+} // namespace com_masaers
+
+
+template<typename Layout, typename Search>
+com_masaers::puzzle_generator<Layout, Search>::puzzle_generator(const int clues, const bool hard)
+  : clues_m(clues)
+  , hard_m(hard)
+  , attempts_m(0)
+  , order_m(Layout::NN)
+{}
+
+template<typename Layout, typename Search>
+bool com_masaers::puzzle_generator<Layout, Search>::operator()(const std::uint64_t seed, const std::uint64_t index, sudoku_board<Layout>& puzzle) {
+  std::seed_seq sequence{std::uint32_t(seed), std::uint32_t(seed >> 32), std::uint32_t(index), std::uint32_t(index >> 32)};
+  random_type random(sequence);
+  bool result = false;
+  for (attempts_m = 1; ! result && attempts_m <= MAX_ATTEMPTS; ++attempts_m) {
+    fill(random, puzzle);
+    shuffle(random, puzzle);
+    result = dig(random, puzzle) && (! hard_m || hard(puzzle));
+  }
+  --attempts_m;
+  return result;
+}
+
+// Fills the board with a random solution: a random first row,
+// completed by search.
+template<typename Layout, typename Search>
+void com_masaers::puzzle_generator<Layout, Search>::fill(random_type& random, sudoku_board<Layout>& board) {
+  int values[Layout::N];
+  for (int i = 0; i < Layout::N; ++i) {
+    values[i] = i;
+  }
+  permute(random, values, Layout::N);
+  board.clear();
+  for (int col = 0; col < Layout::N; ++col) {
+    board.apply_mask(Layout::pos_of_rowcol(0, col), sudoku_board<Layout>::make_mask(values[col]), std::back_inserter(solved_m));
+  }
+  solved_m.clear();
+  board = search_m(trivial_m(board));
+}
+
+// Shuffles the bands, the rows within each band, the stacks and the
+// columns within each stack, which keeps a solved board solved.
+template<typename Layout, typename Search>
+void com_masaers::puzzle_generator<Layout, Search>::shuffle(random_type& random, sudoku_board<Layout>& board) {
+  constexpr int BAND_ROWS = Layout::N / Layout::HOUSES_PER_COL;
+  constexpr int STACK_COLS = Layout::N / Layout::HOUSES_PER_ROW;
+  int bands[Layout::HOUSES_PER_COL];
+  int stacks[Layout::HOUSES_PER_ROW];
+  int rows[Layout::N];
+  int cols[Layout::N];
+  for (int i = 0; i < Layout::N; ++i) {
+    rows[i] = cols[i] = i;
+  }
+  for (int i = 0; i < Layout::HOUSES_PER_COL; ++i) {
+    bands[i] = i;
+    permute(random, rows + i * BAND_ROWS, BAND_ROWS);
+  }
+  for (int i = 0; i < Layout::HOUSES_PER_ROW; ++i) {
+    stacks[i] = i;
+    permute(random, cols + i * STACK_COLS, STACK_COLS);
+  }
+  permute(random, bands, Layout::HOUSES_PER_COL);
+  permute(random, stacks, Layout::HOUSES_PER_ROW);
+  const sudoku_board<Layout> original(board);
+  for (int row = 0; row < Layout::N; ++row) {
+    const int from_row = rows[bands[row / BAND_ROWS] * BAND_ROWS + row % BAND_ROWS];
+    for (int col = 0; col < Layout::N; ++col) {
+      const int from_col = cols[stacks[col / STACK_COLS] * STACK_COLS + col % STACK_COLS];
+      board.restore(Layout::pos_of_rowcol(row, col), original[Layout::pos_of_rowcol(from_row, from_col)]);
+    }
+  }
+}
+
+// Removes clues from a solved board in random order, keeping the
+// solution unique. Returns whether the target number of clues was
+// reached.
+//
+// A clue can go if no solution has another value in its cell: one
+// search for a single solution of the puzzle with the clue ruled out,
+// which most often fails early, instead of counting two solutions.
+template<typename Layout, typename Search>
+bool com_masaers::puzzle_generator<Layout, Search>::dig(random_type& random, sudoku_board<Layout>& board) {
+  typedef typename Layout::cell_type cell_type;
+  const cell_type all = ~cell_type();
+  for (int pos = 0; pos < Layout::NN; ++pos) {
+    order_m[pos] = pos;
+  }
+  permute(random, order_m.data(), Layout::NN);
+  int clues = Layout::NN;
+  for (auto it = order_m.begin(); it != order_m.end() && clues > clues_m; ++it) {
+    const cell_type cell = board[*it];
+    board.restore(*it, all & ~cell);
+    const bool removable = unsolvable(board);
+    board.restore(*it, all);
+    if (removable) {
+      --clues;
+    } else {
+      board.apply_mask(*it, cell, std::back_inserter(solved_m));
+    }
+  }
+  solved_m.clear();
+  bool result = clues <= clues_m || clues_m == 0;
+  return result;
+}
+
+// Whether a board has no solution.
+template<typename Layout, typename Search>
+bool com_masaers::puzzle_generator<Layout, Search>::unsolvable(const sudoku_board<Layout>& board) {
+  bool result = search_m(board, 1).empty();
+  return result;
+}
+
+// Whether a puzzle needs search beyond the deductions of the
+// pseudoku solver.
+template<typename Layout, typename Search>
+bool com_masaers::puzzle_generator<Layout, Search>::hard(const sudoku_board<Layout>& board) {
+  sudoku_board<Layout> propagated = trivial_m(board);
+  pseudoku_m(propagated);
+  bool result = ! propagated.solved();
+  return result;
+}
+
+// Fisher-Yates shuffle of [first, first + size).
+template<typename Layout, typename Search>
+inline void com_masaers::puzzle_generator<Layout, Search>::permute(random_type& random, int* first, const int size) {
+  for (int i = size - 1; i > 0; --i) {
+    std::swap(first[i], first[random() % (i + 1)]);
+  }
+}
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef COM_MASAERS_INPUT_HPP
+#define COM_MASAERS_INPUT_HPP
+#include "sudoku.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace com_masaers {
+  /**
+     Reads puzzles straight from the bytes of their input, in the
+     one-line format (see sudoku_board::read_line) or the grid format
+     of the data/ files (see sudoku_board::read_grid), without going
+     through an istream.
+
+     Regular files are memory mapped, and parsed where they lie. Other
+     inputs, such as stdin and pipes, are read in large blocks into a
+     buffer that keeps the unread tail of the last block, so that a
+     record is never split between two blocks.
+   */
+  class puzzle_reader {
+  public:
+    static constexpr std::size_t BLOCK_SIZE = 1 << 20;
+    enum status_type { read, end, malformed };
+    // Reads from stdin.
+    puzzle_reader();
+    // Reads from a file; see good() and error() for whether it opened.
+    explicit puzzle_reader(const char* path);
+    ~puzzle_reader();
+    puzzle_reader(const puzzle_reader&) = delete;
+    puzzle_reader& operator=(const puzzle_reader&) = delete;
+    bool good() const { return error_m.empty(); }
+    // What went wrong with the last read, or with opening the input.
+    const std::string& error() const { return error_m; }
+    const std::string& name() const { return name_m; }
+    // The line of the input that the last read record started on.
+    std::size_t line() const { return line_m; }
+    // Points [first, last) at the next line, without its line break,
+    // and returns false once the input is used up. The range is valid
+    // until the next read.
+    bool next_line(const char*& first, const char*& last);
+    // Reads the next board in the grid format.
+    template<typename Layout> status_type next_grid(sudoku_board<Layout>& board);
+    // Counts the numbers on the next line that has any, which is the
+    // size N of the next board in the grid format, without reading
+    // past them. Returns 0 at the end of the input.
+    int next_grid_size();
+  protected:
+    bool refill();
+    void count_lines(const char* first, const char* last);
+    void fail(const std::string& message) { error_m = name_m + ":" + std::to_string(line_m) + ": " + message; }
+  private:
+    std::string name_m;
+    int fd_m;
+    char* map_m;
+    std::size_t map_size_m;
+    std::vector<char> buffer_m;
+    const char* next_m;
+    const char* end_m;
+    bool eof_m;
+    // The line that next_m is on.
+    std::size_t next_line_m;
+    std::size_t line_m;
+    std::string error_m;
+  }; // puzzle_reader
+
+  // Describes why [first, last) is not a board in the one-line format.
+  template<typename Layout>
+  std::string line_error(const char* first, const char* last);
+} // namespace com_masaers
+
+
+inline com_masaers::puzzle_reader::puzzle_reader()
+  : name_m("stdin")
+  , fd_m(STDIN_FILENO)
+  , map_m(nullptr)
+  , map_size_m(0)
+  , next_m(nullptr)
+  , end_m(nullptr)
+  , eof_m(false)
+  , next_line_m(1)
+  , line_m(0)
+{}
+
+inline com_masaers::puzzle_reader::puzzle_reader(const char* path)
+  : name_m(path)
+  , fd_m(::open(path, O_RDONLY))
+  , map_m(nullptr)
+  , map_size_m(0)
+  , next_m(nullptr)
+  , end_m(nullptr)
+  , eof_m(false)
+  , next_line_m(1)
+  , line_m(0)
+{
+  struct stat info;
+  if (fd_m < 0) {
+    error_m = "Could not open " + name_m + ": " + std::strerror(errno) + ".";
+    // There is nothing to read, and refill() must not overwrite the
+    // error with one from reading a bad descriptor.
+    eof_m = true;
+  } else if (fstat(fd_m, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd_m, 0);
+    if (map != MAP_FAILED) {
+      map_m = static_cast<char*>(map);
+      map_size_m = info.st_size;
+      madvise(map, map_size_m, MADV_SEQUENTIAL);
+      next_m = map_m;
+      end_m = map_m + map_size_m;
+      eof_m = true;
+    }
+  }
+}
+
+inline com_masaers::puzzle_reader::~puzzle_reader() {
+  if (map_m != nullptr) {
+    munmap(map_m, map_size_m);
+  }
+  if (fd_m >= 0 && fd_m != STDIN_FILENO) {
+    ::close(fd_m);
+  }
+}
+
+// Keeps the unread bytes, and reads the next block after them.
+// Returns false if there was nothing more to read.
+inline bool com_masaers::puzzle_reader::refill() {
+  bool result = false;
+  if (! eof_m) {
+    const std::size_t kept = end_m - next_m;
+    if (kept != 0 && next_m != buffer_m.data()) {
+      std::memmove(buffer_m.data(), next_m, kept);
+    }
+    buffer_m.resize(std::max(buffer_m.size(), kept + BLOCK_SIZE));
+    ssize_t size;
+    do {
+      size = ::read(fd_m, buffer_m.data() + kept, buffer_m.size() - kept);
+    } while (size < 0 && errno == EINTR);
+    if (size < 0) {
+      fail(std::string("read error: ") + std::strerror(errno) + ".");
+    }
+    eof_m = size <= 0;
+    result = size > 0;
+    next_m = buffer_m.data();
+    end_m = next_m + kept + (size > 0 ? size : 0);
+  }
+  return result;
+}
+
+inline void com_masaers::puzzle_reader::count_lines(const char* first, const char* last) {
+  next_line_m += std::count(first, last, '\n');
+}
+
+inline bool com_masaers::puzzle_reader::next_line(const char*& first, const char*& last) {
+  const char* newline = nullptr;
+  while (true) {
+    if (next_m != end_m) {
+      newline = static_cast<const char*>(std::memchr(next_m, '\n', end_m - next_m));
+    }
+    if (newline != nullptr || ! refill()) {
+      break;
+    }
+  }
+  bool result = newline != nullptr || next_m != end_m;
+  if (result) {
+    first = next_m;
+    last = newline != nullptr ? newline : end_m;
+    next_m = newline != nullptr ? newline + 1 : end_m;
+    if (last != first && last[-1] == '\r') {
+      --last;
+    }
+    line_m = next_line_m++;
+  }
+  return result;
+}
+
+inline int com_masaers::puzzle_reader::next_grid_size() {
+  int result = 0;
+  // Where the line being looked at starts, counted from next_m, which
+  // stays put when the buffer is refilled.
+  std::size_t offset = 0;
+  while (result == 0) {
+    const char* first = next_m + offset;
+    const char* newline = nullptr;
+    if (first != end_m) {
+      newline = static_cast<const char*>(std::memchr(first, '\n', end_m - first));
+    }
+    if (newline == nullptr && refill()) {
+      continue;
+    }
+    // A refill that found nothing more may still have moved the kept
+    // bytes to the front of the buffer.
+    first = next_m + offset;
+    bool number = false;
+    for (const char* it = first; it != (newline != nullptr ? newline : end_m); ++it) {
+      const bool digit = *it >= '0' && *it <= '9';
+      result += digit && ! number;
+      number = digit;
+    }
+    if (newline == nullptr) {
+      break;
+    }
+    offset = newline + 1 - next_m;
+  }
+  return result;
+}
+
+template<typename Layout>
+com_masaers::puzzle_reader::status_type com_masaers::puzzle_reader::next_grid(sudoku_board<Layout>& board) {
+  status_type result = end;
+  bool done = false;
+  while (! done) {
+    const char* first = next_m;
+    // Skip to the first number, to know which line the board is on.
+    while (first != end_m && (*first == ' ' || (*first >= '\t' && *first <= '\r'))) {
+      ++first;
+    }
+    const char* start = first;
+    const bool parsed = first != end_m && board.read_grid(first, end_m);
+    // A board that runs into the end of the buffer may go on in the
+    // next block. Refilling moves the unread bytes, so remember where
+    // the board was relative to next_m.
+    if (first == end_m) {
+      const std::size_t start_offset = start - next_m;
+      const std::size_t first_offset = first - next_m;
+      if (refill()) {
+        continue;
+      }
+      start = next_m + start_offset;
+      first = next_m + first_offset;
+    }
+    done = true;
+    if (next_m == end_m) {
+      // Nothing but white space was left.
+      break;
+    }
+    count_lines(next_m, start);
+    line_m = next_line_m;
+    count_lines(start, first);
+    next_m = first;
+    if (parsed) {
+      result = read;
+    } else if (start != end_m) {
+      // Report the line of the wrong character, and stop reading.
+      result = malformed;
+      line_m = next_line_m;
+      fail(first == end_m ? std::string("the board ends early.") : std::string("unexpected '") + *first + "' in a board.");
+      next_m = end_m;
+    }
+  }
+  return result;
+}
+
+template<typename Layout>
+std::string com_masaers::line_error(const char* first, const char* last) {
+  std::string result;
+  for (const char* it = first; result.empty() && it != last; ++it) {
+    if (sudoku_symbols<Layout::N>::value_of(*it) < 0) {
+      result = "unexpected '" + std::string(1, *it) + "' in cell " + std::to_string(it - first + 1) + ".";
+    }
+  }
+  if (result.empty() && last - first != Layout::NN) {
+    result = "expected " + std::to_string(Layout::NN) + " cells, found " + std::to_string(last - first) + ".";
+  }
+  return result;
+}
+
+#endif
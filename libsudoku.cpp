@@ -0,0 +1,94 @@
+#include "libsudoku.h"
+#include "sudoku.hpp"
+#include "solver.hpp"
+#include "bitboard.hpp"
+#include "registry.hpp"
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+// What the C interface sees of the context of every layout.
+struct sudoku_context {
+  virtual ~sudoku_context() {}
+  virtual int cells() const = 0;
+  virtual int solve(const char* in, char* out, const int max_solutions) = 0;
+};
+
+namespace {
+  /**
+     The board, the solvers and all the scratch space that solving a
+     puzzle of a layout takes, made once. 9x9 boards are solved by the
+     bitboard engine, and other layouts by depth first search.
+   */
+  template<typename Layout>
+  class layout_context : public sudoku_context {
+  public:
+    int cells() const override { return Layout::NN; }
+    int solve(const char* in, char* out, const int max_solutions) override;
+  protected:
+    typedef typename std::conditional<std::is_same<Layout, com_masaers::sudoku_layout<3> >::value,
+                                      com_masaers::bitboard_solver,
+                                      com_masaers::depth_first_solver<Layout> >::type search_type;
+  private:
+    com_masaers::sudoku_board<Layout> board_m;
+    com_masaers::trivial_solver<Layout> trivial_m;
+    search_type search_m;
+  }; // layout_context
+} // namespace
+
+
+template<typename Layout>
+int layout_context<Layout>::solve(const char* in, char* out, const int max_solutions) {
+  using namespace com_masaers;
+  int result = SUDOKU_MALFORMED;
+  *out = '\0';
+  if (strnlen(in, Layout::NN + 1) == std::size_t(Layout::NN) && board_m.read_line(in, in + Layout::NN)) {
+    if (! board_m.valid()) {
+      result = SUDOKU_INVALID;
+    } else {
+      result = 0;
+      board_m = trivial_m(board_m);
+      if (board_m.valid() && board_m.solved()) {
+        *board_m.write_line(out) = '\0';
+        result = 1;
+      } else {
+        const int limit = max_solutions < 1 ? 1 : max_solutions;
+        search_m.visit(board_m, [&](const sudoku_board<Layout>& solution) {
+            if (result == 0) {
+              *solution.write_line(out) = '\0';
+            }
+            return ++result < limit;
+          });
+      }
+    }
+  }
+  return result;
+}
+
+sudoku_context* sudoku_context_create(const int size) {
+  using namespace com_masaers;
+  sudoku_context* result = nullptr;
+  const int layout = supported_layouts::index_of_size(size);
+  if (layout != supported_layouts::SIZE) {
+    try {
+      supported_layouts::visit(layout, [&](auto tag) {
+          result = new layout_context<typename decltype(tag)::type>();
+        });
+    } catch (const std::bad_alloc&) {
+      result = nullptr;
+    }
+  }
+  return result;
+}
+
+void sudoku_context_destroy(sudoku_context* context) {
+  delete context;
+}
+
+int sudoku_context_cells(const sudoku_context* context) {
+  return context->cells();
+}
+
+int sudoku_solve(sudoku_context* context, const char* in, char* out, const int max_solutions) {
+  return context->solve(in, out, max_solutions);
+}
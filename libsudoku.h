@@ -0,0 +1,56 @@
+#ifndef COM_MASAERS_LIBSUDOKU_H
+#define COM_MASAERS_LIBSUDOKU_H
+
+/*
+   The solvers as a library with a C interface, built by the Makefile
+   as build/lib/libsudoku.a and build/lib/libsudoku.so.
+
+   A context holds the solver of one board size and all the memory
+   that it needs, so that solving allocates nothing. Contexts share
+   nothing that changes, so every thread can solve in parallel with
+   its own context; a context must not be used by two threads at once.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sudoku_context sudoku_context;
+
+/* What sudoku_solve returns for a puzzle that is not size x size
+   symbols in the compact format. */
+#define SUDOKU_MALFORMED (-1)
+/* What sudoku_solve returns for a puzzle that has the same value
+   twice in some row, column or house. */
+#define SUDOKU_INVALID (-2)
+
+/* Makes a context for size x size boards, where size is one of 4, 6,
+   9, 12, 16, 25 and 36. Returns NULL for other sizes, or if there is
+   not enough memory. */
+sudoku_context* sudoku_context_create(int size);
+
+/* Frees a context and everything in it. */
+void sudoku_context_destroy(sudoku_context* context);
+
+/* The number of cells of the boards of a context: the length of the
+   puzzles that sudoku_solve reads, and of the solutions that it
+   writes, not counting the terminating NUL. */
+int sudoku_context_cells(const sudoku_context* context);
+
+/* Solves the puzzle in the NUL-terminated string in, in the compact
+   one-line format ('1'-'9' and then 'A'-'Z' and 'a'-'z' for values,
+   '.' or '0' for blanks). Writes the first solution found to out,
+   which must have room for sudoku_context_cells(context) + 1 chars,
+   or an empty string if there is none.
+
+   Looks for at most max_solutions solutions (at least one), and
+   returns how many there are up to that, so that a max_solutions of 2
+   tells whether a puzzle is unique. Returns SUDOKU_MALFORMED or
+   SUDOKU_INVALID instead if the puzzle is not one. */
+int sudoku_solve(sudoku_context* context, const char* in, char* out, int max_solutions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
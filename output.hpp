@@ -0,0 +1,139 @@
+#ifndef COM_MASAERS_OUTPUT_HPP
+#define COM_MASAERS_OUTPUT_HPP
+#include "sudoku.hpp"
+#include "timer.hpp"
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+namespace com_masaers {
+  /**
+     Writes boards and text to a stream through a buffer that is kept
+     from one board to the next, and handed to the stream in large
+     chunks. Nothing is flushed until the buffer fills up, flush() is
+     called or the writer goes away.
+
+     Boards are written in one of three formats: compact (see
+     sudoku_board::write_line), grid (see sudoku_board::write_grid) or
+     pencilmarks (see sudoku_board::write_pencilmarks). In quiet mode,
+     the input boards are not echoed, and only results are written.
+   */
+  class puzzle_writer {
+  public:
+    enum format_type { compact, grid, pencilmarks };
+    static constexpr std::size_t FLUSH_SIZE = 1 << 16;
+    // Looks up a format by its name; returns false if there is none.
+    static bool parse_format(const char* name, format_type& format);
+    explicit puzzle_writer(std::ostream& os, const format_type format = pencilmarks, const bool quiet = false);
+    ~puzzle_writer() { flush(); }
+    puzzle_writer(const puzzle_writer&) = delete;
+    puzzle_writer& operator=(const puzzle_writer&) = delete;
+    format_type format() const { return format_m; }
+    bool quiet() const { return quiet_m; }
+    // Writes a result board in the format of the writer, followed by
+    // an empty line in the formats that take several lines.
+    template<typename Layout> puzzle_writer& write(const sudoku_board<Layout>& board);
+    // Writes an input board, unless the writer is quiet.
+    template<typename Layout> puzzle_writer& echo(const sudoku_board<Layout>& board);
+    // Writes text, numbers or anything else that can be written to an
+    // ostream.
+    template<typename T> puzzle_writer& operator<<(const T& x);
+    // Timers format themselves with stream manipulators, so they go
+    // through a string stream in one piece.
+    puzzle_writer& operator<<(const timer& x);
+    // The buffer, for callers that format straight into it; call
+    // commit() when done.
+    std::string& buffer() { return buffer_m; }
+    // Hands the buffer to the stream if it has filled up.
+    void commit() { if (buffer_m.size() >= FLUSH_SIZE) { write_out(); } }
+    // Hands the buffer to the stream, and flushes the stream.
+    void flush() { write_out(); os_m.flush(); }
+  protected:
+    void write_out() { os_m.write(buffer_m.data(), buffer_m.size()); buffer_m.clear(); }
+  private:
+    std::ostream& os_m;
+    format_type format_m;
+    bool quiet_m;
+    std::string buffer_m;
+    std::ostringstream text_m;
+  }; // puzzle_writer
+} // namespace com_masaers
+
+
+inline bool com_masaers::puzzle_writer::parse_format(const char* name, format_type& format) {
+  bool result = true;
+  if (std::strcmp(name, "compact") == 0) {
+    format = compact;
+  } else if (std::strcmp(name, "grid") == 0) {
+    format = grid;
+  } else if (std::strcmp(name, "pencilmarks") == 0) {
+    format = pencilmarks;
+  } else {
+    result = false;
+  }
+  return result;
+}
+
+inline com_masaers::puzzle_writer::puzzle_writer(std::ostream& os, const format_type format, const bool quiet)
+  : os_m(os)
+  , format_m(format)
+  , quiet_m(quiet)
+{
+  buffer_m.reserve(FLUSH_SIZE + (FLUSH_SIZE >> 2));
+}
+
+template<typename Layout>
+com_masaers::puzzle_writer& com_masaers::puzzle_writer::write(const sudoku_board<Layout>& board) {
+  switch (format_m) {
+  case compact:
+    board.write_line(std::back_inserter(buffer_m));
+    break;
+  case grid:
+    board.write_grid(std::back_inserter(buffer_m));
+    break;
+  default:
+    board.write_pencilmarks(std::back_inserter(buffer_m));
+    break;
+  }
+  buffer_m += '\n';
+  commit();
+  return *this;
+}
+
+template<typename Layout>
+com_masaers::puzzle_writer& com_masaers::puzzle_writer::echo(const sudoku_board<Layout>& board) {
+  if (! quiet_m) {
+    write(board);
+  }
+  return *this;
+}
+
+template<typename T>
+com_masaers::puzzle_writer& com_masaers::puzzle_writer::operator<<(const T& x) {
+  if constexpr (std::is_same<T, char>::value) {
+    buffer_m += x;
+  } else if constexpr (std::is_integral<T>::value) {
+    buffer_m += std::to_string(x);
+  } else if constexpr (std::is_convertible<const T&, const char*>::value || std::is_same<T, std::string>::value) {
+    buffer_m += x;
+  } else {
+    text_m.str(std::string());
+    text_m << x;
+    buffer_m += text_m.str();
+  }
+  commit();
+  return *this;
+}
+
+inline com_masaers::puzzle_writer& com_masaers::puzzle_writer::operator<<(const timer& x) {
+  text_m.str(std::string());
+  text_m << x;
+  buffer_m += text_m.str();
+  commit();
+  return *this;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef COM_MASAERS_PARALLEL_SOLVER_HPP
+#define COM_MASAERS_PARALLEL_SOLVER_HPP
+#include "sudoku.hpp"
+#include "solver.hpp"
+#include "pool.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace com_masaers {
+  /**
+     Depth first search over several threads for a single puzzle.
+
+     Each subtree is searched depth first by one worker, in place on a
+     board of its own. Whenever some worker is idle, a busy worker
+     splits off the shallowest pending alternative of its search (the
+     largest pending subtree) as a new task, which the idle worker then
+     steals. All workers stop as soon as the requested number of
+     solutions has been found.
+   */
+  template<typename Layout, typename Branching = hidden_candidate_branching, typename Propagation = naked_single_propagation<Layout> >
+  class parallel_depth_first_solver {
+  public:
+    explicit parallel_depth_first_solver(const std::size_t threads);
+    const sudoku_board<Layout>& operator()(const sudoku_board<Layout>& board);
+    const std::vector<sudoku_board<Layout> >& operator()(const sudoku_board<Layout>& board, std::size_t solutions);
+  protected:
+    class worker_type : public depth_first_solver<Layout, Branching, Propagation> {
+    public:
+      void run(parallel_depth_first_solver& parent, const std::size_t worker, const sudoku_board<Layout>& board);
+    }; // worker_type
+    void submit(const std::size_t worker, const sudoku_board<Layout>& board);
+    void add_solution(const sudoku_board<Layout>& board);
+  private:
+    work_stealing_pool pool_m;
+    std::vector<worker_type> workers_m;
+    std::vector<sudoku_board<Layout> > solutions_m;
+    std::size_t max_solutions_m;
+    std::mutex mutex_m;
+    std::atomic<bool> stop_m;
+  }; // parallel_depth_first_solver
+} // namespace com_masaers
+
+
+template<typename Layout, typename Branching, typename Propagation>
+com_masaers::parallel_depth_first_solver<Layout, Branching, Propagation>::parallel_depth_first_solver(const std::size_t threads)
+  : pool_m(threads)
+  , workers_m(pool_m.size())
+  , max_solutions_m(0)
+  , stop_m(false)
+{}
+
+template<typename Layout, typename Branching, typename Propagation>
+inline const com_masaers::sudoku_board<Layout>& com_masaers::parallel_depth_first_solver<Layout, Branching, Propagation>::operator()(const sudoku_board<Layout>& board) {
+  operator()(board, 1);
+  if (solutions_m.empty()) {
+    return board;
+  } else {
+    return solutions_m.front();
+  }
+}
+
+template<typename Layout, typename Branching, typename Propagation>
+const std::vector<com_masaers::sudoku_board<Layout> >& com_masaers::parallel_depth_first_solver<Layout, Branching, Propagation>::operator()(const sudoku_board<Layout>& board, std::size_t solutions) {
+  solutions_m.clear();
+  max_solutions_m = solutions;
+  stop_m.store(solutions == 0);
+  submit(0, board);
+  pool_m.wait();
+  return solutions_m;
+}
+
+template<typename Layout, typename Branching, typename Propagation>
+inline void com_masaers::parallel_depth_first_solver<Layout, Branching, Propagation>::submit(const std::size_t worker, const sudoku_board<Layout>& board) {
+  pool_m.submit(worker, [this, board](const std::size_t w) {
+      workers_m[w].run(*this, w, board);
+    });
+}
+
+template<typename Layout, typename Branching, typename Propagation>
+void com_masaers::parallel_depth_first_solver<Layout, Branching, Propagation>::add_solution(const sudoku_board<Layout>& board) {
+  std::lock_guard<std::mutex> lock(mutex_m);
+  if (solutions_m.size() < max_solutions_m) {
+    solutions_m.emplace_back(board);
+  }
+  if (solutions_m.size() >= max_solutions_m) {
+    stop_m.store(true);
+  }
+}
+
+template<typename Layout, typename Branching, typename Propagation>
+void com_masaers::parallel_depth_first_solver<Layout, Branching, Propagation>::worker_type::run(parallel_depth_first_solver& parent, const std::size_t worker, const sudoku_board<Layout>& board) {
+  sudoku_board<Layout> subtree;
+  this->search(board, [&]() {
+      if (parent.stop_m.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      if (parent.pool_m.idle() > parent.pool_m.queued() && this->split(subtree)) {
+        parent.submit(worker, subtree);
+      }
+      return true;
+    }, [&parent](const sudoku_board<Layout>& solution) {
+      parent.add_solution(solution);
+      return ! parent.stop_m.load();
+    });
+}
+
+#endif
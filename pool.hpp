@@ -0,0 +1,159 @@
+#ifndef COM_MASAERS_POOL_HPP
+#define COM_MASAERS_POOL_HPP
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace com_masaers {
+  /**
+     A fixed set of worker threads, each with its own task deque.
+     Workers take tasks from the back of their own deque, and steal
+     from the front of the other deques when their own runs dry, so a
+     long running task only ever holds up itself.
+
+     Tasks are called with the index of the worker running them, which
+     lets the caller keep per-worker state (such as solvers) without
+     any locking.
+   */
+  class work_stealing_pool {
+  public:
+    typedef std::function<void(const std::size_t)> task_type;
+    explicit work_stealing_pool(const std::size_t workers);
+    ~work_stealing_pool();
+    std::size_t size() const { return queues_m.size(); }
+    std::size_t idle() const { return idle_m.load(); }
+    std::size_t queued() const { return queued_m.load(); }
+    void submit(task_type task);
+    void submit(const std::size_t worker, task_type task);
+    void wait();
+  protected:
+    struct queue_type {
+      std::mutex mutex;
+      std::deque<task_type> tasks;
+    };
+    bool pop(const std::size_t worker, task_type& task);
+    bool steal(const std::size_t worker, task_type& task);
+    void run(const std::size_t worker);
+  private:
+    std::vector<queue_type> queues_m;
+    std::vector<std::thread> threads_m;
+    std::mutex mutex_m;
+    std::condition_variable work_m;
+    std::condition_variable done_m;
+    std::atomic<std::size_t> queued_m;
+    std::atomic<std::size_t> pending_m;
+    std::atomic<std::size_t> idle_m;
+    std::atomic<std::size_t> next_m;
+    bool stop_m;
+  }; // work_stealing_pool
+} // namespace com_masaers
+
+
+inline com_masaers::work_stealing_pool::work_stealing_pool(const std::size_t workers)
+  : queues_m(workers == 0 ? 1 : workers)
+  , queued_m(0)
+  , pending_m(0)
+  , idle_m(0)
+  , next_m(0)
+  , stop_m(false)
+{
+  for (std::size_t i = 0; i < queues_m.size(); ++i) {
+    threads_m.emplace_back(&work_stealing_pool::run, this, i);
+  }
+}
+
+inline com_masaers::work_stealing_pool::~work_stealing_pool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    stop_m = true;
+  }
+  work_m.notify_all();
+  for (auto it = threads_m.begin(); it != threads_m.end(); ++it) {
+    it->join();
+  }
+}
+
+// Submits a task to the workers in round robin order.
+inline void com_masaers::work_stealing_pool::submit(task_type task) {
+  submit(next_m++ % queues_m.size(), std::move(task));
+}
+
+// Submits a task to the back of the deque of a specific worker.
+inline void com_masaers::work_stealing_pool::submit(const std::size_t worker, task_type task) {
+  ++pending_m;
+  {
+    queue_type& queue = queues_m[worker % queues_m.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.emplace_back(std::move(task));
+  }
+  {
+    // Counting under the pool mutex keeps sleeping workers from
+    // missing the notification.
+    std::lock_guard<std::mutex> lock(mutex_m);
+    ++queued_m;
+  }
+  work_m.notify_one();
+}
+
+// Blocks until every submitted task (including tasks submitted by
+// other tasks) has finished.
+inline void com_masaers::work_stealing_pool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_m);
+  done_m.wait(lock, [this]() { return pending_m.load() == 0; });
+}
+
+inline bool com_masaers::work_stealing_pool::pop(const std::size_t worker, task_type& task) {
+  bool result = false;
+  queue_type& queue = queues_m[worker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (! queue.tasks.empty()) {
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    --queued_m;
+    result = true;
+  }
+  return result;
+}
+
+inline bool com_masaers::work_stealing_pool::steal(const std::size_t worker, task_type& task) {
+  bool result = false;
+  for (std::size_t i = 1; ! result && i < queues_m.size(); ++i) {
+    queue_type& queue = queues_m[(worker + i) % queues_m.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (! queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      --queued_m;
+      result = true;
+    }
+  }
+  return result;
+}
+
+inline void com_masaers::work_stealing_pool::run(const std::size_t worker) {
+  task_type task;
+  while (true) {
+    if (pop(worker, task) || steal(worker, task)) {
+      task(worker);
+      task = nullptr;
+      if (--pending_m == 0) {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        done_m.notify_all();
+      }
+    } else {
+      std::unique_lock<std::mutex> lock(mutex_m);
+      if (stop_m && queued_m.load() == 0) {
+        break;
+      }
+      ++idle_m;
+      work_m.wait(lock, [this]() { return stop_m || queued_m.load() != 0; });
+      --idle_m;
+    }
+  }
+}
+
+#endif
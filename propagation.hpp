@@ -0,0 +1,102 @@
+#ifndef COM_MASAERS_PROPAGATION_HPP
+#define COM_MASAERS_PROPAGATION_HPP
+#include "sudoku.hpp"
+#include "pseudoku.hpp"
+#include <iterator>
+#include <vector>
+
+namespace com_masaers {
+  // Propagation policies decide how much reasoning depth first search
+  // does in every node, on top of the naked singles that the trivial
+  // solver always propagates. Each policy is called with the board of
+  // a node that has no naked singles left to propagate, records every
+  // change it makes on the trail, and returns false if it finds that
+  // the board has no solution. Stronger policies cost more per node,
+  // but leave smaller trees to search.
+
+  /**
+     Does nothing beyond the naked singles of the trivial solver.
+   */
+  template<typename Layout>
+  class naked_single_propagation {
+  public:
+    template<typename Trail>
+    bool operator()(sudoku_board<Layout>&, Trail&&) { return true; }
+  }; // naked_single_propagation
+
+  /**
+     Also places every value that fits in only one cell of some row,
+     column or house (hidden singles), and fails when some value fits
+     nowhere in a unit, until neither kind of single is left.
+   */
+  template<typename Layout>
+  class hidden_single_propagation {
+  public:
+    hidden_single_propagation() : agenda_next_m(0) { agenda_m.reserve(Layout::NN); }
+    template<typename Trail>
+    bool operator()(sudoku_board<Layout>& board, Trail&& trail);
+  private:
+    std::vector<int> agenda_m;
+    // The first cell of the agenda that is not yet propagated.
+    std::size_t agenda_next_m;
+  }; // hidden_single_propagation
+
+  /**
+     Runs every deduction of pseudoku_solver: hidden singles, pointing
+     and claiming between lines and houses, and naked and hidden
+     subsets.
+   */
+  template<typename Layout>
+  class pseudoku_propagation {
+  public:
+    template<typename Trail>
+    bool operator()(sudoku_board<Layout>& board, Trail&& trail) { return solver_m(board, trail); }
+  private:
+    pseudoku_solver<Layout> solver_m;
+  }; // pseudoku_propagation
+} // namespace com_masaers
+
+
+template<typename Layout>
+template<typename Trail>
+bool com_masaers::hidden_single_propagation<Layout>::operator()(sudoku_board<Layout>& board, Trail&& trail) {
+  typedef typename Layout::cell_type cell_type;
+  const cell_type all = ~cell_type();
+  bool result = true;
+  bool changed = true;
+  while (result && changed) {
+    changed = false;
+    for (int unit = 0; result && unit < Layout::UNITS; ++unit) {
+      // Values seen in at least one, and in at least two cells.
+      cell_type once;
+      cell_type twice;
+      for (int i = 0; i < Layout::N; ++i) {
+        const cell_type& cell = board[Layout::pos_of_unit(unit, i)];
+        twice |= once & cell;
+        once |= cell;
+      }
+      result = once == all;
+      const cell_type singles = once & ~twice;
+      for (int i = 0; result && singles.any() && i < Layout::N; ++i) {
+        const int pos = Layout::pos_of_unit(unit, i);
+        if (! board.solved(pos)) {
+          const cell_type mask = board[pos] & singles;
+          if (mask.any()) {
+            // Two values that only fit here cannot both be placed.
+            result = mask.single() && board.apply_mask(pos, mask, std::back_inserter(agenda_m), trail);
+            changed = true;
+          }
+        }
+      }
+      while (result && agenda_next_m != agenda_m.size()) {
+        result = board.propagate_solution(agenda_m[agenda_next_m++], std::back_inserter(agenda_m), trail);
+      }
+      agenda_m.clear();
+      agenda_next_m = 0;
+    }
+  }
+  agenda_m.clear();
+  return result;
+}
+
+#endif
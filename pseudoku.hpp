@@ -1,10 +1,9 @@
 #ifndef COM_MASAERS_PSEUDOKU_HPP
 #define COM_MASAERS_PSEUDOKU_HPP
 #include "sudoku.hpp"
-#include <unordered_map>
-#include <unordered_set>
-#include <deque>
 #include <array>
+#include <type_traits>
+#include <vector>
 
 namespace com_masaers {
   /**
@@ -13,164 +12,349 @@ namespace com_masaers {
   template<typename Layout = sudoku_layout<3, 3> >
   class pseudoku_solver {
   public:
-    typedef std::deque<int> agenda_type;
+    typedef std::vector<int> agenda_type;
+    // Every cell is solved at most once between two clear_agenda()
+    // calls, so the agenda never grows past its first reservation.
+    pseudoku_solver() : agenda_next_m(0) { agenda_m.reserve(Layout::NN); }
     agenda_type& agenda() { return agenda_m; }
-    void clear_agenda(sudoku_board<Layout>& board) {
-      while (! agenda_m.empty()) {
-        board.propagate_solution(agenda_m.front(), back_inserter(agenda_m));
-        agenda_m.pop_front();
+    bool clear_agenda(sudoku_board<Layout>& board) {
+      return clear_agenda(board, no_trail());
+    }
+    // Propagates every solved cell on the agenda. Returns false, and
+    // leaves the agenda empty, if some cell runs out of values.
+    template<typename Trail>
+    bool clear_agenda(sudoku_board<Layout>& board, Trail&& trail) {
+      bool result = true;
+      while (result && agenda_next_m != agenda_m.size()) {
+        result = board.propagate_solution(agenda_m[agenda_next_m++], back_inserter(agenda_m), trail);
       }
+      agenda_m.clear();
+      agenda_next_m = 0;
+      return result;
     }
-    void process_row(sudoku_board<Layout>& board, const int row) {
+    // The process methods make their deductions within one unit, and
+    // return false if some deduction left a cell without values. Cells
+    // that they solve are put on the agenda rather than propagated.
+    template<typename Trail>
+    bool process_row(sudoku_board<Layout>& board, const int row, Trail&& trail) {
       using namespace std;
       typedef typename sudoku_board<Layout>::cell_type cell_type;
       auto solved_it = back_inserter(agenda_m);
+      bool result = true;
       // Analyze row
-      std::array<cell_type, board.L::N> backward;
-      std::array<cell_type, board.L.HOUSES_PER_ROW> field_out;
-      std::array<cell_type, board.L.HOUSES_PER_ROW> field_in;
-      unordered_map<cell_type, unordered_set<int> > uniq_sets;
-      for (int c = 0; c < board.L.N; ++c) {
-        const int pos = board.L.pos_of_rowcol(row, c);
+      std::array<cell_type, Layout::N> backward;
+      std::array<cell_type, Layout::HOUSES_PER_ROW> field_out;
+      std::array<cell_type, Layout::HOUSES_PER_ROW> field_in;
+      for (int c = 0; c < Layout::N; ++c) {
+        const int pos = Layout::pos_of_rowcol(row, c);
         const cell_type& cell = board[pos];
         if (c != 0) {
-          backward[board.L.N-1 - c] = backward[board.L.N - c] | board[board.L.pos_of_rowcol(row, board.L.N - c)];
+          backward[Layout::N-1 - c] = backward[Layout::N - c] | board[Layout::pos_of_rowcol(row, Layout::N - c)];
         }
-        const int f = board.L.house_of_pos(pos) % board.L.HOUSES_PER_ROW;
+        const int f = Layout::house_of_pos(pos) % Layout::HOUSES_PER_ROW;
         field_in[f] |= cell;
-        for (int i = 1; i < board.L.HOUSES_PER_ROW; ++i) {
-          field_out[(f + i) % board.L.HOUSES_PER_ROW] |= cell;
-        }
-        if (cell.count() > 1) {
-          uniq_sets[cell].insert(c);
-        }
-      }
-      // Find unique sets and eliminate their members from other cells
-      // in the same row
-      for (auto it = begin(uniq_sets); it != end(uniq_sets); ++it) {
-        if (it->first.count() == it->second.size()) {
-          for (auto c = 0; c < board.L.N; ++c) {
-            if (it->second.find(c) == it->second.end()) {
-              board.apply_mask(board.L.pos_of_rowcol(row, c), ~it->first, solved_it);
-            }
-          }
+        for (int i = 1; i < Layout::HOUSES_PER_ROW; ++i) {
+          field_out[(f + i) % Layout::HOUSES_PER_ROW] |= cell;
         }
       }
       // Find cells that have row-unique numbers and commit to them
       cell_type forward;
-      for (int c = 0; c < board.L.N; ++c) {
-        const int pos = board.L.pos_of_rowcol(row, c);
-        board.try_mask(pos, ~(backward[c] | forward), solved_it);
+      for (int c = 0; c < Layout::N; ++c) {
+        const int pos = Layout::pos_of_rowcol(row, c);
+        board.try_mask(pos, ~(backward[c] | forward), solved_it, trail);
         forward |= board[pos];
       }
       // Find rows in fields that have row-unique numbers and
       // eliminate the numbers from rest of house.
-      for (int fc = 0; fc < board.L.HOUSES_PER_ROW; ++fc) {
+      for (int fc = 0; fc < Layout::HOUSES_PER_ROW; ++fc) {
         const cell_type mask = field_in[fc] & ~field_out[fc];
         if (mask.any()) {
-          const int f = board.L.house_of_pos(board.L.pos_of_rowcol(row, fc * board.L.HOUSES_PER_ROW));
-          for (int c = 0; c < board.L.N; ++c) {
-            const int pos = board.L.pos_of_houseroom(f, c);
-            if (board.L.row_of_pos(pos) != row) {
-              board.apply_mask(pos, ~mask, solved_it);
+          // Stacks are N / HOUSES_PER_ROW columns wide.
+          const int f = Layout::house_of_pos(Layout::pos_of_rowcol(row, fc * (Layout::N / Layout::HOUSES_PER_ROW)));
+          for (int c = 0; c < Layout::N; ++c) {
+            const int pos = Layout::pos_of_houseroom(f, c);
+            if (Layout::row_of_pos(pos) != row) {
+              result = board.apply_mask(pos, ~mask, solved_it, trail) && result;
             }
           }
         }
       }
+      return result;
     }
-    void process_column(sudoku_board<Layout>& board, const int col) {
+    template<typename Trail>
+    bool process_column(sudoku_board<Layout>& board, const int col, Trail&& trail) {
       using namespace std;
       typedef typename sudoku_board<Layout>::cell_type cell_type;
       auto solved_it = back_inserter(agenda_m);
+      bool result = true;
       // Analyze column
-      cell_type backward[board.L.N];
-      cell_type field_out[board.L.HOUSES_PER_COL];
-      cell_type field_in[board.L.HOUSES_PER_COL];
-      unordered_map<cell_type, unordered_set<int> > uniq_sets;
-      for (int c = 0; c < board.L.N; ++c) {
-        const int pos = board.L.pos_of_rowcol(c, col);
+      cell_type backward[Layout::N];
+      cell_type field_out[Layout::HOUSES_PER_COL];
+      cell_type field_in[Layout::HOUSES_PER_COL];
+      for (int c = 0; c < Layout::N; ++c) {
+        const int pos = Layout::pos_of_rowcol(c, col);
         const cell_type& cell = board[pos];
         if (c != 0) {
-          backward[board.L.N-1 - c] = backward[board.L.N - c] | board[board.L.pos_of_rowcol(board.L.N - c, col)];
+          backward[Layout::N-1 - c] = backward[Layout::N - c] | board[Layout::pos_of_rowcol(Layout::N - c, col)];
         }
-        const int f = board.L.house_of_pos(pos) / board.L.HOUSES_PER_COL;
+        const int f = Layout::house_of_pos(pos) / Layout::HOUSES_PER_ROW;
         field_in[f] |= cell;
-        for (int foff = 1; foff < board.L.HOUSES_PER_COL; ++foff) {
-          field_out[(f + foff) % board.L.HOUSES_PER_COL] |= cell;
-        }
-        if(cell.count() > 1) {
-          uniq_sets[cell].insert(c);
-        }
-      }
-      // Find unique sets and eliminate their members from other cells
-      // in the same column
-      for (auto it = begin(uniq_sets); it != end(uniq_sets); ++it) {
-        if (it->first.count() == it->second.size()) {
-          for (auto c = 0; c < board.L.N; ++c) {
-            if (it->second.find(c) == it->second.end()) {
-              board.apply_mask(board.L.pos_of_rowcol(c, col), ~it->first, solved_it);
-            }
-          }
+        for (int foff = 1; foff < Layout::HOUSES_PER_COL; ++foff) {
+          field_out[(f + foff) % Layout::HOUSES_PER_COL] |= cell;
         }
       }
       // Find cells that have column-unique numbers and commit to them
       cell_type forward;
-      for (int c = 0; c < board.L.N; ++c) {
-        const int pos = board.L.pos_of_rowcol(c, col);
-        board.try_mask(pos, ~(backward[c] | forward), solved_it);
+      for (int c = 0; c < Layout::N; ++c) {
+        const int pos = Layout::pos_of_rowcol(c, col);
+        board.try_mask(pos, ~(backward[c] | forward), solved_it, trail);
         forward |= board[pos];
       }
       // Find columns in fields that have column-unique numbers and
       // eliminate the numbers from rest of field.
-      for (int fc = 0; fc < board.L.HOUSES_PER_COL; ++fc) {
+      for (int fc = 0; fc < Layout::HOUSES_PER_COL; ++fc) {
         const cell_type mask = field_in[fc] & ~field_out[fc];
         if (mask.any()) {
-          const int f = board.L.house_of_pos(board.L.pos_of_rowcol(fc * board.L.HOUSES_PER_COL, col));
-          for (int c = 0; c < board.L.N; ++c) {
-            const int pos = board.L.pos_of_houseroom(f, c);
-            if (board.L.col_of_pos(pos) != col) {
-              board.apply_mask(pos, ~mask, solved_it);
+          // Bands are N / HOUSES_PER_COL rows high.
+          const int f = Layout::house_of_pos(Layout::pos_of_rowcol(fc * (Layout::N / Layout::HOUSES_PER_COL), col));
+          for (int c = 0; c < Layout::N; ++c) {
+            const int pos = Layout::pos_of_houseroom(f, c);
+            if (Layout::col_of_pos(pos) != col) {
+              result = board.apply_mask(pos, ~mask, solved_it, trail) && result;
             }
           }
         }
       }
+      return result;
     }
-    void process_field(sudoku_board<Layout>& board, const int field) {
+    template<typename Trail>
+    bool process_field(sudoku_board<Layout>& board, const int field, Trail&& trail) {
       using namespace std;
       typedef typename sudoku_board<Layout>::cell_type cell_type;
       auto solved_it = back_inserter(agenda_m);
+      bool result = true;
       // Analyze field
-      cell_type backward[board.L.N];
-      for (int c = board.L.N-1; c > 0; --c) {
-        const auto& cell = board[board.L.pos_of_houseroom(field, c)];
+      cell_type backward[Layout::N];
+      for (int c = Layout::N-1; c > 0; --c) {
+        const auto& cell = board[Layout::pos_of_houseroom(field, c)];
         backward[c-1] = backward[c] | cell;
       }
       // Find cells that have field-unique numbers and commit to them
       cell_type forward;
-      for (int c = 0; c < board.L.N; ++c) {
+      for (int c = 0; c < Layout::N; ++c) {
         const cell_type mask = ~backward[c] & ~forward;
-        const int pos = board.L.pos_of_houseroom(field, c);
-        board.try_mask(pos, mask, solved_it);
+        const int pos = Layout::pos_of_houseroom(field, c);
+        board.try_mask(pos, mask, solved_it, trail);
         forward |= board[pos];
       }
+      // Find numbers that only fit in one row or column of the field,
+      // and eliminate them from the rest of that row or column. Fields
+      // are N / HOUSES_PER_COL rows high and N / HOUSES_PER_ROW
+      // columns wide.
+      constexpr int ROWS = Layout::N / Layout::HOUSES_PER_COL;
+      constexpr int COLS = Layout::N / Layout::HOUSES_PER_ROW;
+      cell_type row_in[ROWS];
+      cell_type col_in[COLS];
+      for (int c = 0; c < Layout::N; ++c) {
+        const cell_type& cell = board[Layout::pos_of_houseroom(field, c)];
+        row_in[c / COLS] |= cell;
+        col_in[c % COLS] |= cell;
+      }
+      for (int r = 0; r < ROWS; ++r) {
+        cell_type out;
+        for (int i = 1; i < ROWS; ++i) {
+          out |= row_in[(r + i) % ROWS];
+        }
+        const cell_type mask = row_in[r] & ~out;
+        if (mask.any()) {
+          const int row = Layout::row_of_pos(Layout::pos_of_houseroom(field, r * COLS));
+          for (int c = 0; c < Layout::N; ++c) {
+            const int pos = Layout::pos_of_rowcol(row, c);
+            if (Layout::house_of_pos(pos) != field) {
+              result = board.apply_mask(pos, ~mask, solved_it, trail) && result;
+            }
+          }
+        }
+      }
+      for (int fc = 0; fc < COLS; ++fc) {
+        cell_type out;
+        for (int i = 1; i < COLS; ++i) {
+          out |= col_in[(fc + i) % COLS];
+        }
+        const cell_type mask = col_in[fc] & ~out;
+        if (mask.any()) {
+          const int col = Layout::col_of_pos(Layout::pos_of_houseroom(field, fc));
+          for (int c = 0; c < Layout::N; ++c) {
+            const int pos = Layout::pos_of_rowcol(c, col);
+            if (Layout::house_of_pos(pos) != field) {
+              result = board.apply_mask(pos, ~mask, solved_it, trail) && result;
+            }
+          }
+        }
+      }
+      return result;
     }
-    void operator()(sudoku_board<Layout>& board) {
-      clear_agenda(board);
-      while (true) {
-        const int unknown = board.unknown();
-        for (int rcf = 0; rcf < board.L.N; ++rcf) {
-          process_row(board, rcf);
-          process_column(board, rcf);
-          process_field(board, rcf);
+    // Finds naked and hidden subsets of up to MAX_SUBSET cells in a
+    // unit (see sudoku_layout::pos_of_unit). A naked subset is k cells
+    // that share k values between them, which can then be removed from
+    // the rest of the unit. A hidden subset is k values that only fit
+    // in k cells, which can then hold nothing else.
+    template<typename Trail>
+    bool process_subsets(sudoku_board<Layout>& board, const int unit, Trail&& trail) {
+      typedef typename sudoku_board<Layout>::cell_type cell_type;
+      auto solved_it = back_inserter(agenda_m);
+      bool result = true;
+      // Unsolved cells of the unit by their values, and unplaced values
+      // by the indices of the cells they fit in. Both are plain
+      // cell_type masks, with cells counted within the unit.
+      int positions[Layout::N];
+      cell_type cells[Layout::N];
+      int cell_count = 0;
+      int values[Layout::N];
+      cell_type places[Layout::N];
+      int value_count = 0;
+      cell_type placed;
+      for (int i = 0; i < Layout::N; ++i) {
+        const int pos = Layout::pos_of_unit(unit, i);
+        const cell_type& cell = board[pos];
+        if (board.solved(cell)) {
+          placed |= cell;
+        } else {
+          positions[cell_count] = pos;
+          cells[cell_count++] = cell;
+        }
+      }
+      for (int value = 0; value < Layout::N; ++value) {
+        if (! placed[value]) {
+          cell_type place;
+          for (int i = 0; i < cell_count; ++i) {
+            if (cells[i][value]) {
+              place.set(i);
+            }
+          }
+          // Single and impossible values are left to propagation and
+          // hidden singles.
+          if (place.count() > 1) {
+            values[value_count] = value;
+            places[value_count++] = place;
+          }
         }
-        clear_agenda(board);
-        if (board.unknown() == unknown) {
-          break;
+      }
+      for (int k = 2; k <= MAX_SUBSET && k < cell_count; ++k) {
+        find_subsets(cells, cell_count, k, 0, cell_type(), cell_type(), [&](const cell_type& members, const cell_type& union_) {
+            for (int i = 0; i < cell_count; ++i) {
+              if (! members[i]) {
+                result = board.apply_mask(positions[i], ~union_, solved_it, trail) && result;
+              }
+            }
+          });
+      }
+      for (int k = 2; k <= MAX_SUBSET && k < value_count; ++k) {
+        find_subsets(places, value_count, k, 0, cell_type(), cell_type(), [&](const cell_type& members, const cell_type& union_) {
+            cell_type mask;
+            for (int v = members.first(); v < Layout::N; v = members.next(v)) {
+              mask.set(values[v]);
+            }
+            for (int i = union_.first(); i < Layout::N; i = union_.next(i)) {
+              result = board.apply_mask(positions[i], mask, solved_it, trail) && result;
+            }
+          });
+      }
+      return result;
+    }
+    // Runs the cheap deductions for the Uth unit (see
+    // sudoku_layout::pos_of_unit): hidden singles in every unit,
+    // claiming from rows and columns, and pointing from houses.
+    template<typename Trail>
+    bool process_unit(sudoku_board<Layout>& board, const int unit, Trail&& trail) {
+      return unit < Layout::N ? process_row(board, unit, trail)
+        : unit < 2 * Layout::N ? process_column(board, unit - Layout::N, trail)
+        : process_field(board, unit - 2 * Layout::N, trail);
+    }
+    void operator()(sudoku_board<Layout>& board) {
+      operator()(board, no_trail());
+    }
+    // Applies every deduction until none of them changes the board.
+    // Returns false if the board turned out to have no solution.
+    //
+    // Only units with a cell that changed since they were last
+    // processed are processed again. Subsets are only looked for once
+    // the cheaper deductions have nothing left to do.
+    template<typename Trail>
+    bool operator()(sudoku_board<Layout>& board, Trail&& trail) {
+      unit_set dirty;
+      unit_set subsets_dirty;
+      dirty.set();
+      subsets_dirty.set();
+      dirty_unit_trail<typename std::remove_reference<Trail>::type> tracked = { trail, dirty, subsets_dirty };
+      units_processed_m = 0;
+      bool result = clear_agenda(board, tracked);
+      while (result && (dirty.any() || subsets_dirty.any())) {
+        ++units_processed_m;
+        if (dirty.any()) {
+          const int unit = dirty.first();
+          dirty.reset(unit);
+          result = process_unit(board, unit, tracked);
+        } else {
+          const int unit = subsets_dirty.first();
+          subsets_dirty.reset(unit);
+          result = process_subsets(board, unit, tracked);
         }
+        result = result && clear_agenda(board, tracked);
       }
+      agenda_m.clear();
+      agenda_next_m = 0;
+      return result;
     }
+    // The number of units that the last call to operator() processed.
+    std::size_t units_processed() const { return units_processed_m; }
   protected:
+    typedef sudoku_cell<Layout::UNITS> unit_set;
+    // Passes every change on to another trail, and marks the units of
+    // the changed cell as needing to be processed again.
+    template<typename Trail>
+    struct dirty_unit_trail {
+      Trail& trail;
+      unit_set& dirty;
+      unit_set& subsets_dirty;
+      void record(const int pos, const typename Layout::cell_type& cell) {
+        trail.record(pos, cell);
+        const int row = Layout::row_of_pos(pos);
+        const int col = Layout::N + Layout::col_of_pos(pos);
+        const int house = 2 * Layout::N + Layout::house_of_pos(pos);
+        dirty.set(row).set(col).set(house);
+        subsets_dirty.set(row).set(col).set(house);
+      }
+    }; // dirty_unit_trail
+    // The largest naked or hidden subset looked for (quads).
+    static constexpr int MAX_SUBSET = 4;
+    // Calls found(members, union) for every combination of k of the
+    // count sets whose union has exactly k elements. Combinations are
+    // built in index order from first, and a prefix whose union already
+    // has more than k elements is not extended.
+    template<typename Found>
+    static void find_subsets(const typename Layout::cell_type* sets, const int count, const int k, const int first,
+                             const typename Layout::cell_type& members, const typename Layout::cell_type& union_,
+                             Found&& found) {
+      const int size = members.count();
+      if (size == k) {
+        if (static_cast<int>(union_.count()) == k) {
+          found(members, union_);
+        }
+      } else {
+        for (int i = first; i < Layout::N && i + (k - size) <= count; ++i) {
+          const typename Layout::cell_type extended = union_ | sets[i];
+          if (static_cast<int>(extended.count()) <= k) {
+            typename Layout::cell_type with = members;
+            find_subsets(sets, count, k, i + 1, with.set(i), extended, found);
+          }
+        }
+      }
+    }
     agenda_type agenda_m;
+    // The first cell of the agenda that is not yet propagated.
+    std::size_t agenda_next_m;
+    std::size_t units_processed_m = 0;
   }; // pseudoku_solver
 } // namespace com_masaers
 
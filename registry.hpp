@@ -0,0 +1,102 @@
+#ifndef COM_MASAERS_REGISTRY_HPP
+#define COM_MASAERS_REGISTRY_HPP
+#include "sudoku.hpp"
+#include <cstddef>
+#include <string>
+#include <tuple>
+
+namespace com_masaers {
+  /**
+     Stands for a layout in calls to the visitors of layout_registry,
+     which are generic lambdas that get the layout as tag_type::type.
+   */
+  template<typename Layout>
+  struct layout_tag {
+    typedef Layout type;
+  }; // layout_tag
+
+  /**
+     A list of layouts that are built into a binary, and the lookup of
+     the one that an input record belongs to at run time. Every layout
+     keeps its own fully specialized engines: the registry only picks
+     which one to call, once per record, and nothing past that point
+     knows the size of a board at run time.
+
+     Two layouts with the same number of values (such as 2x3 and 3x2
+     houses) cannot be told apart by the size of a record, and the
+     first one listed wins.
+   */
+  template<typename... Layouts>
+  class layout_registry {
+  public:
+    // The number of layouts, which is also what the lookups return for
+    // a size that no layout has.
+    static constexpr int SIZE = sizeof...(Layouts);
+    // Something of every layout, such as one solver each.
+    template<template<typename> class F>
+    using tuple_type = std::tuple<F<Layouts>...>;
+    // The index of the layout with N values.
+    static int index_of_size(const int n);
+    // The index of the layout with this many cells.
+    static int index_of_cells(const std::size_t cells);
+    // Calls visitor(layout_tag<Layout>()) with the layout of an index
+    // that is less than SIZE.
+    template<typename Visitor> static void visit(const int index, Visitor&& visitor);
+    // Calls visitor(layout_tag<Layout>()) with every layout in turn.
+    template<typename Visitor> static void for_each(Visitor&& visitor);
+    // Lists the sizes of the layouts, as in "4x4, 9x9 or 16x16".
+    static std::string names();
+  }; // layout_registry
+
+  // The layouts that the binaries are built with: the common square
+  // sizes, and the common non-square ones with houses one row shorter
+  // than they are wide.
+  typedef layout_registry<sudoku_layout<2>, sudoku_layout<2, 3>, sudoku_layout<3>, sudoku_layout<3, 4>, sudoku_layout<4>, sudoku_layout<5>, sudoku_layout<6> > supported_layouts;
+} // namespace com_masaers
+
+
+template<typename... Layouts>
+int com_masaers::layout_registry<Layouts...>::index_of_size(const int n) {
+  int result = SIZE;
+  int i = 0;
+  ((result == SIZE && Layouts::N == n ? result = i : 0, ++i), ...);
+  return result;
+}
+
+template<typename... Layouts>
+int com_masaers::layout_registry<Layouts...>::index_of_cells(const std::size_t cells) {
+  int result = SIZE;
+  int i = 0;
+  ((result == SIZE && std::size_t(Layouts::NN) == cells ? result = i : 0, ++i), ...);
+  return result;
+}
+
+template<typename... Layouts>
+template<typename Visitor>
+void com_masaers::layout_registry<Layouts...>::visit(const int index, Visitor&& visitor) {
+  int i = 0;
+  ((i++ == index ? (visitor(layout_tag<Layouts>()), 0) : 0), ...);
+}
+
+template<typename... Layouts>
+template<typename Visitor>
+void com_masaers::layout_registry<Layouts...>::for_each(Visitor&& visitor) {
+  (visitor(layout_tag<Layouts>()), ...);
+}
+
+template<typename... Layouts>
+std::string com_masaers::layout_registry<Layouts...>::names() {
+  std::string result;
+  int i = 0;
+  for_each([&](auto tag) {
+      typedef typename decltype(tag)::type layout_type;
+      if (i != 0) {
+        result += i + 1 == SIZE ? " or " : ", ";
+      }
+      result += std::to_string(layout_type::N) + "x" + std::to_string(layout_type::N);
+      ++i;
+    });
+  return result;
+}
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef COM_MASAERS_SERVER_HPP
+#define COM_MASAERS_SERVER_HPP
+#include "batch.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace com_masaers {
+  // Set by stop_serving.
+  inline volatile std::sig_atomic_t serving_stopped = 0;
+
+  // Makes every puzzle_server return from serving once it next wakes
+  // up. Takes a signal number, so that it can be a signal handler.
+  inline void stop_serving(const int = 0) { serving_stopped = 1; }
+
+  /**
+     Answers puzzles for as long as it runs, so that clients pay
+     neither for starting a process nor for cold solvers. Clients send
+     puzzles in the compact one-line format, one per line, and get one
+     line back for every line they send, in order: the solution (or
+     the puzzle itself if there is none), a space, and the status
+     (solved, unsolvable, invalid or malformed; see batch_solver).
+
+     The server either listens on a Unix domain socket, or talks to a
+     single client over stdin and stdout. It waits for input with
+     poll(), and whenever it wakes up, solves every complete line that
+     has come in from any client as one batch, on a mixed_batch_solver
+     that keeps its solvers (and their worker threads) from one batch
+     to the next. A lone request is thereby answered right away, while
+     requests that come in together under load are solved together.
+   */
+  template<typename Registry, template<typename> class SearchOf>
+  class puzzle_server {
+  public:
+    // The most that is read from a client at a time.
+    static constexpr std::size_t READ_SIZE = 1 << 16;
+    // The longest line a client may send before it is disconnected.
+    static constexpr std::size_t MAX_LINE = 1 << 16;
+    // A client is not read from while this much output waits for it.
+    static constexpr std::size_t MAX_PENDING = 1 << 20;
+    explicit puzzle_server(const std::size_t threads, solution_cache* cache = nullptr);
+    ~puzzle_server();
+    puzzle_server(const puzzle_server&) = delete;
+    puzzle_server& operator=(const puzzle_server&) = delete;
+    // Serves stdin and stdout until stdin ends or stop_serving() is
+    // called. Returns false, with error() set, if serving failed.
+    bool serve_stdio();
+    // Serves clients on a Unix domain socket at path until
+    // stop_serving() is called, and removes the socket afterwards.
+    bool serve_socket(const char* path);
+    const std::string& error() const { return error_m; }
+    // The number of lines answered, and of batches they came in.
+    std::size_t requests() const { return requests_m; }
+    std::size_t batches() const { return batches_m; }
+    batch_phases phases() const { return solve_m.phases(); }
+  protected:
+    struct client_type {
+      int in;
+      int out;
+      // Read but not yet answered, and answered but not yet written.
+      std::string input;
+      std::string output;
+      // Whether the client is done sending, or has failed.
+      bool closing;
+      client_type(const int in, const int out) : in(in), out(out), closing(false) {}
+      // Whether to read more from the client: not once it is done
+      // sending, nor while too much output waits for it.
+      bool reading() const { return ! closing && output.size() < MAX_PENDING; }
+    };
+    bool run();
+    void accept_clients();
+    void read_client(client_type& client);
+    void write_client(client_type& client);
+    void solve_pending();
+    void close_client(client_type& client);
+    void fail(const std::string& what) { error_m = what + ": " + std::strerror(errno) + "."; }
+  private:
+    mixed_batch_solver<Registry, SearchOf> solve_m;
+    int listen_m;
+    std::string path_m;
+    std::vector<std::unique_ptr<client_type> > clients_m;
+    // The client of every line in the batch being solved.
+    std::vector<client_type*> owners_m;
+    std::vector<pollfd> polls_m;
+    std::vector<char> buffer_m;
+    std::size_t requests_m;
+    std::size_t batches_m;
+    std::string error_m;
+  }; // puzzle_server
+} // namespace com_masaers
+
+
+template<typename Registry, template<typename> class SearchOf>
+com_masaers::puzzle_server<Registry, SearchOf>::puzzle_server(const std::size_t threads, solution_cache* cache)
+  : solve_m(threads, cache)
+  , listen_m(-1)
+  , buffer_m(READ_SIZE)
+  , requests_m(0)
+  , batches_m(0)
+{}
+
+template<typename Registry, template<typename> class SearchOf>
+com_masaers::puzzle_server<Registry, SearchOf>::~puzzle_server() {
+  for (auto& client : clients_m) {
+    close_client(*client);
+  }
+  if (listen_m >= 0) {
+    ::close(listen_m);
+    ::unlink(path_m.c_str());
+  }
+}
+
+template<typename Registry, template<typename> class SearchOf>
+bool com_masaers::puzzle_server<Registry, SearchOf>::serve_stdio() {
+  // Neither end may block the other: a client that is still writing
+  // puzzles must not stall on answers that the server cannot write.
+  const int in_flags = fcntl(STDIN_FILENO, F_GETFL);
+  const int out_flags = fcntl(STDOUT_FILENO, F_GETFL);
+  fcntl(STDIN_FILENO, F_SETFL, in_flags | O_NONBLOCK);
+  fcntl(STDOUT_FILENO, F_SETFL, out_flags | O_NONBLOCK);
+  clients_m.emplace_back(new client_type(STDIN_FILENO, STDOUT_FILENO));
+  const bool result = run();
+  fcntl(STDIN_FILENO, F_SETFL, in_flags);
+  fcntl(STDOUT_FILENO, F_SETFL, out_flags);
+  return result;
+}
+
+template<typename Registry, template<typename> class SearchOf>
+bool com_masaers::puzzle_server<Registry, SearchOf>::serve_socket(const char* path) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (std::strlen(path) >= sizeof(address.sun_path)) {
+    error_m = std::string("Socket path too long: ") + path + ".";
+    return false;
+  }
+  std::strcpy(address.sun_path, path);
+  // A socket left behind by an earlier server is in the way of bind(),
+  // but nothing else at the path is removed.
+  struct stat info;
+  if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+    ::unlink(path);
+  }
+  listen_m = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_m < 0) {
+    fail("Could not create a socket");
+    return false;
+  }
+  if (bind(listen_m, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    fail(std::string("Could not bind to ") + path);
+    ::close(listen_m);
+    listen_m = -1;
+    return false;
+  }
+  path_m = path;
+  if (listen(listen_m, SOMAXCONN) != 0) {
+    fail(std::string("Could not listen on ") + path);
+    return false;
+  }
+  return run();
+}
+
+// Waits for clients to connect, send or take output, and serves them,
+// until there is nothing left to serve or stop_serving() is called.
+template<typename Registry, template<typename> class SearchOf>
+bool com_masaers::puzzle_server<Registry, SearchOf>::run() {
+  bool result = true;
+  while (serving_stopped == 0 && (listen_m >= 0 || ! clients_m.empty())) {
+    polls_m.clear();
+    if (listen_m >= 0) {
+      polls_m.push_back(pollfd{ listen_m, POLLIN, 0 });
+    }
+    for (const auto& client : clients_m) {
+      const bool reading = client->reading();
+      if (client->in == client->out) {
+        polls_m.push_back(pollfd{ client->in, short((reading ? POLLIN : 0) | (client->output.empty() ? 0 : POLLOUT)), 0 });
+      } else {
+        // poll() reports a hang up even on a descriptor that is asked
+        // for no events, which would keep waking it up once stdin has
+        // ended, so one that is not read from is left out.
+        polls_m.push_back(pollfd{ reading ? client->in : -1, POLLIN, 0 });
+        polls_m.push_back(pollfd{ client->out, short(client->output.empty() ? 0 : POLLOUT), 0 });
+      }
+    }
+    if (poll(polls_m.data(), polls_m.size(), -1) < 0) {
+      if (errno != EINTR) {
+        fail("Could not wait for clients");
+        result = false;
+        break;
+      }
+      continue;
+    }
+    std::size_t next = 0;
+    if (listen_m >= 0 && (polls_m[next++].revents & POLLIN) != 0) {
+      accept_clients();
+    }
+    // Clients accepted just now are polled next time around.
+    const std::size_t polled = clients_m.size();
+    for (std::size_t i = 0; i < polled && next < polls_m.size(); ++i) {
+      client_type& client = *clients_m[i];
+      const short in_events = polls_m[next++].revents;
+      if (client.in != client.out) {
+        ++next;
+      }
+      // The output is not touched between polling and here, so this
+      // is the same as when the client was polled.
+      if (client.reading() && (in_events & (POLLIN | POLLHUP | POLLERR)) != 0) {
+        read_client(client);
+      }
+    }
+    solve_pending();
+    for (std::size_t i = 0; i < clients_m.size(); ) {
+      client_type& client = *clients_m[i];
+      write_client(client);
+      if (client.closing && client.output.empty()) {
+        close_client(client);
+        clients_m.erase(clients_m.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+  }
+  return result;
+}
+
+template<typename Registry, template<typename> class SearchOf>
+void com_masaers::puzzle_server<Registry, SearchOf>::accept_clients() {
+  int fd;
+  while ((fd = accept4(listen_m, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    clients_m.emplace_back(new client_type(fd, fd));
+  }
+}
+
+// Reads what the client has sent. A client that is done sending gets
+// its last line answered even without a line break.
+template<typename Registry, template<typename> class SearchOf>
+void com_masaers::puzzle_server<Registry, SearchOf>::read_client(client_type& client) {
+  ssize_t size;
+  do {
+    size = ::read(client.in, buffer_m.data(), buffer_m.size());
+  } while (size < 0 && errno == EINTR);
+  if (size > 0) {
+    client.input.append(buffer_m.data(), size);
+  } else if (size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+    client.closing = true;
+    if (! client.input.empty() && client.input.back() != '\n') {
+      client.input += '\n';
+    }
+  }
+}
+
+// Answers every complete line of every client in one batch.
+template<typename Registry, template<typename> class SearchOf>
+void com_masaers::puzzle_server<Registry, SearchOf>::solve_pending() {
+  solve_m.clear();
+  owners_m.clear();
+  for (auto& client : clients_m) {
+    const char* const begin = client->input.data();
+    const char* const end = begin + client->input.size();
+    const char* first = begin;
+    const char* newline;
+    while ((newline = static_cast<const char*>(std::memchr(first, '\n', end - first))) != nullptr) {
+      const char* last = newline;
+      if (last != first && last[-1] == '\r') {
+        --last;
+      }
+      solve_m.add(first, last, requests_m + owners_m.size() + 1);
+      owners_m.push_back(client.get());
+      first = newline + 1;
+    }
+    client->input.erase(0, first - begin);
+    if (client->input.size() > MAX_LINE) {
+      client->input.clear();
+      client->closing = true;
+    }
+  }
+  if (! owners_m.empty()) {
+    solve_m.solve(true);
+    for (std::size_t i = 0; i < owners_m.size(); ++i) {
+      owners_m[i]->output += solve_m.output(i);
+    }
+    requests_m += owners_m.size();
+    ++batches_m;
+  }
+}
+
+// Writes as much of the output as the client takes without blocking.
+// The output of a client that has gone away is dropped.
+template<typename Registry, template<typename> class SearchOf>
+void com_masaers::puzzle_server<Registry, SearchOf>::write_client(client_type& client) {
+  std::size_t written = 0;
+  while (written < client.output.size()) {
+    const char* const data = client.output.data() + written;
+    const std::size_t size = client.output.size() - written;
+    ssize_t result;
+    do {
+      result = client.in == client.out ? ::send(client.out, data, size, MSG_NOSIGNAL) : ::write(client.out, data, size);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        written = client.output.size();
+        client.closing = true;
+      }
+      break;
+    }
+    written += result;
+  }
+  client.output.erase(0, written);
+}
+
+template<typename Registry, template<typename> class SearchOf>
+void com_masaers::puzzle_server<Registry, SearchOf>::close_client(client_type& client) {
+  if (client.in != STDIN_FILENO) {
+    ::close(client.in);
+  }
+  if (client.out != client.in && client.out != STDOUT_FILENO) {
+    ::close(client.out);
+  }
+}
+
+#endif
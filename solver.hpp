@@ -1,78 +1,173 @@
+#ifndef COM_MASAERS_SOLVER_HPP
+#define COM_MASAERS_SOLVER_HPP
 #include "sudoku.hpp"
+#include "branching.hpp"
+#include "propagation.hpp"
+#include "stats.hpp"
 #include <algorithm>
+#include <limits>
 #include <vector>
 
 namespace com_masaers {
 
-  template<typename Layout>
+  /**
+     Propagates naked singles until there are none left. Stats is the
+     statistics policy (see stats.hpp).
+
+     The agenda is a queue kept in a vector that is never shrunk. A
+     cell only goes on it when it is first solved, so it never holds
+     more than NN cells, and solving allocates nothing once the solver
+     has been made.
+   */
+  template<typename Layout, typename Stats = no_stats>
   class trivial_solver {
   public:
+    trivial_solver() : agenda_next_m(0) { agenda_m.reserve(Layout::NN); }
     sudoku_board<Layout> operator()(sudoku_board<Layout> board);
+    // The statistics of the last call.
+    const Stats& stats() const { return stats_m; }
   protected:
     void analyze_board(const sudoku_board<Layout>& board);
     bool propagate_solutions(sudoku_board<Layout>& board);
+    template<typename Trail> bool propagate_solutions(sudoku_board<Layout>& board, Trail&& trail);
     bool apply_mask(sudoku_board<Layout>& board, int pos, const typename sudoku_board<Layout>::cell_type& mask);
+    template<typename Trail> bool apply_mask(sudoku_board<Layout>& board, int pos, const typename sudoku_board<Layout>::cell_type& mask, Trail&& trail);
   private:
-    std::deque<int> agenda_m;
-    std::deque<int>& agenda();
+    std::vector<int> agenda_m;
+    // The first cell of the agenda that is not yet propagated.
+    std::size_t agenda_next_m;
+    std::vector<int>& agenda();
+  protected:
+    Stats stats_m;
   }; // trivial_solver
 
 
-  template<typename Layout>
-  class depth_first_solver : trivial_solver<Layout> {
+  /**
+     Depth first search, with the trivial solver applied in every node.
+     Which alternatives to branch on is decided by the Branching policy
+     (see branching.hpp), and any further reasoning done in every node
+     by the Propagation policy (see propagation.hpp). Stats counts
+     the work done (see stats.hpp), not counting the work done inside
+     the Propagation policy.
+
+     The search works on a single board in place. Every change is
+     recorded on a trail, and backtracking undoes the changes made
+     since the node was entered, rather than keeping copies of boards.
+     The trail and the stack of nodes are made large enough for the
+     deepest search up front, so that count() and visit() allocate
+     nothing.
+   */
+  template<typename Layout, typename Branching = hidden_candidate_branching, typename Propagation = naked_single_propagation<Layout>, typename Stats = no_stats>
+  class depth_first_solver : trivial_solver<Layout, Stats> {
   public:
+    using trivial_solver<Layout, Stats>::stats;
+    depth_first_solver();
     const sudoku_board<Layout>& operator()(const sudoku_board<Layout>& board);
     const std::vector<sudoku_board<Layout> >& operator()(const sudoku_board<Layout>& board, std::size_t solutions);
+    std::size_t count(const sudoku_board<Layout>& board, std::size_t limit = std::numeric_limits<std::size_t>::max());
+    template<typename Visitor> std::size_t visit(const sudoku_board<Layout>& board, Visitor&& visitor);
+    // The number of nodes entered by the last search.
+    std::size_t nodes() const { return nodes_m; }
   protected:
+    struct frame_type {
+      std::pair<int, int> alternatives[Layout::N];
+      int next;
+      int last;
+      std::size_t mark;
+    }; // frame_type
     void depth_first(const sudoku_board<Layout>& board, std::size_t solutions);
+    template<typename Node, typename Solution> void search(const sudoku_board<Layout>& board, Node&& node, Solution&& solution);
+    bool split(sudoku_board<Layout>& board);
+    template<typename Trail> bool propagate(sudoku_board<Layout>& board, int pos, int value, Trail&& trail);
   private:
+    Propagation propagation_m;
+    sudoku_board<Layout> board_m;
+    sudoku_trail<Layout> trail_m;
+    std::vector<frame_type> frames_m;
     std::vector<sudoku_board<Layout> > solutions_m;
+    std::size_t nodes_m = 0;
   }; // depth_first_solver
 
 } // namespace com_masaers
 
 
-template<typename Layout>
-inline com_masaers::sudoku_board<Layout> com_masaers::trivial_solver<Layout>::operator()(sudoku_board<Layout> board) {
+template<typename Layout, typename Stats>
+inline com_masaers::sudoku_board<Layout> com_masaers::trivial_solver<Layout, Stats>::operator()(sudoku_board<Layout> board) {
+  stats_m.clear();
   analyze_board(board);
-  propagate_solutions(board);
+  if (! propagate_solutions(board)) {
+    stats_m.contradiction();
+  }
   return board;
 }
 
-template<typename Layout>
-inline std::deque<int>& com_masaers::trivial_solver<Layout>::agenda() {
+template<typename Layout, typename Stats>
+inline std::vector<int>& com_masaers::trivial_solver<Layout, Stats>::agenda() {
   return agenda_m;
 }
 
-template<typename Layout>
-inline void com_masaers::trivial_solver<Layout>::analyze_board(const sudoku_board<Layout>& board) {
+template<typename Layout, typename Stats>
+inline void com_masaers::trivial_solver<Layout, Stats>::analyze_board(const sudoku_board<Layout>& board) {
   agenda_m.clear();
   for (int pos = 0; pos < Layout::NN; ++pos) {
     if (board.solved(pos)) {
       agenda_m.emplace_back(pos);
     }
   }
+  stats_m.agenda_pushes(agenda_m.size());
 }
 
-template<typename Layout>
-inline bool com_masaers::trivial_solver<Layout>::propagate_solutions(sudoku_board<Layout>& board) {
+template<typename Layout, typename Stats>
+inline bool com_masaers::trivial_solver<Layout, Stats>::propagate_solutions(sudoku_board<Layout>& board) {
+  return propagate_solutions(board, no_trail());
+}
+
+template<typename Layout, typename Stats>
+template<typename Trail>
+inline bool com_masaers::trivial_solver<Layout, Stats>::propagate_solutions(sudoku_board<Layout>& board, Trail&& trail) {
   bool result = true;
-  while (result && ! agenda_m.empty()) {
-    result = board.propagate_solution(agenda_m.front(), back_inserter(agenda_m));
-    agenda_m.pop_front();
+  while (result && agenda_next_m != agenda_m.size()) {
+    const std::size_t size = agenda_m.size();
+    // As sudoku_board::propagate_solution, but counting the masks that
+    // are applied before a contradiction stops it.
+    const int pos = agenda_m[agenda_next_m++];
+    const typename sudoku_board<Layout>::cell_type mask = ~board[pos];
+    for (auto it = Layout::first_peer(pos); result && it != Layout::last_peer(pos); ++it) {
+      result = board.apply_mask(*it, mask, back_inserter(agenda_m), trail);
+      stats_m.apply_masks(1);
+    }
+    stats_m.agenda_pushes(agenda_m.size() - size);
   }
   agenda_m.clear();
+  agenda_next_m = 0;
   return result;
 }
 
-template<typename Layout>
-inline bool com_masaers::trivial_solver<Layout>::apply_mask(sudoku_board<Layout>& board, int pos, const typename sudoku_board<Layout>::cell_type& mask) {
-  return board.apply_mask(pos, mask, back_inserter(agenda_m))
-  &&     propagate_solutions(board);
+template<typename Layout, typename Stats>
+inline bool com_masaers::trivial_solver<Layout, Stats>::apply_mask(sudoku_board<Layout>& board, int pos, const typename sudoku_board<Layout>::cell_type& mask) {
+  return apply_mask(board, pos, mask, no_trail());
+}
+
+template<typename Layout, typename Stats>
+template<typename Trail>
+inline bool com_masaers::trivial_solver<Layout, Stats>::apply_mask(sudoku_board<Layout>& board, int pos, const typename sudoku_board<Layout>::cell_type& mask, Trail&& trail) {
+  const std::size_t size = agenda_m.size();
+  const bool result = board.apply_mask(pos, mask, back_inserter(agenda_m), trail);
+  stats_m.agenda_pushes(agenda_m.size() - size);
+  stats_m.apply_masks(1);
+  return result && propagate_solutions(board, trail);
+}
+
+// Every change on the trail takes at least one value out of a cell,
+// and every node below the root solves at least one cell.
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::depth_first_solver() {
+  trail_m.reserve(Layout::NN * Layout::N);
+  frames_m.reserve(Layout::NN + 1);
 }
 
-template<typename Layout>
-inline const com_masaers::sudoku_board<Layout>& com_masaers::depth_first_solver<Layout>::operator()(const sudoku_board<Layout>& board) {
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+inline const com_masaers::sudoku_board<Layout>& com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::operator()(const sudoku_board<Layout>& board) {
   solutions_m.clear();
   depth_first(board, 1);
   if (solutions_m.empty()) {
@@ -82,36 +177,124 @@ inline const com_masaers::sudoku_board<Layout>& com_masaers::depth_first_solver<
   }
 }
 
-template<typename Layout>
-inline const std::vector<com_masaers::sudoku_board<Layout> >& com_masaers::depth_first_solver<Layout>::operator()(const sudoku_board<Layout>& board, std::size_t solutions) {
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+inline const std::vector<com_masaers::sudoku_board<Layout> >& com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::operator()(const sudoku_board<Layout>& board, std::size_t solutions) {
   solutions_m.clear();
   depth_first(board, solutions);
   return solutions_m;
 }
 
-template<typename Layout>
-void com_masaers::depth_first_solver<Layout>::depth_first(const sudoku_board<Layout>& board, std::size_t solutions) {
-  std::vector<sudoku_board<Layout> > frontier{{ board }};
-  while (! frontier.empty() && solutions_m.size() < solutions) {
-    if (frontier.back().solved()) {
-      solutions_m.emplace_back(frontier.back());
-      frontier.pop_back();
+// Counts the solutions of board, up to limit, without keeping any of
+// them. A limit of 2 is enough to tell unique puzzles from the rest.
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+inline std::size_t com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::count(const sudoku_board<Layout>& board, std::size_t limit) {
+  std::size_t result = 0;
+  if (limit != 0) {
+    search(board, []() { return true; }, [&result, limit](const sudoku_board<Layout>&) {
+        return ++result < limit;
+      });
+  }
+  return result;
+}
+
+// Calls visitor with every solution of board as soon as it is found.
+// The board passed to the visitor is only valid during the call, and
+// the search stops as soon as the visitor returns false. Returns the
+// number of solutions visited.
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+template<typename Visitor>
+inline std::size_t com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::visit(const sudoku_board<Layout>& board, Visitor&& visitor) {
+  std::size_t result = 0;
+  search(board, []() { return true; }, [&result, &visitor](const sudoku_board<Layout>& solution) {
+      ++result;
+      return visitor(solution);
+    });
+  return result;
+}
+
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+void com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::depth_first(const sudoku_board<Layout>& board, std::size_t solutions) {
+  if (solutions != 0) {
+    search(board, []() { return true; }, [this, solutions](const sudoku_board<Layout>& b) {
+        solutions_m.emplace_back(b);
+        return solutions_m.size() < solutions;
+      });
+  }
+}
+
+// Searches the subtree under board. Before every alternative is
+// tried, node() is asked whether to go on, and every solution found
+// is passed to solution(), which also returns whether to go on.
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+template<typename Node, typename Solution>
+void com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::search(const sudoku_board<Layout>& board, Node&& node, Solution&& solution) {
+  board_m = board;
+  trail_m.clear();
+  frames_m.clear();
+  nodes_m = 0;
+  this->stats_m.clear();
+  bool consistent = propagation_m(board_m, trail_m);
+  while (node()) {
+    ++nodes_m;
+    this->stats_m.node();
+    if (! consistent) {
+      this->stats_m.contradiction();
     } else {
-      sudoku_board<Layout> b = frontier.back();
-      frontier.pop_back();
-      for (int pos = 0; pos < Layout::NN; ++pos) {
-        if (! b.solved(pos)) {
-          for (int value = 0; value < Layout::N; ++value) {
-            if (b[pos][value]) {
-              frontier.emplace_back(b);
-              if (! this->apply_mask(frontier.back(), pos, sudoku_board<Layout>::make_mask(value))) {
-                frontier.pop_back();
-              }
-            }
-          }
+      if (board_m.solved()) {
+        if (! solution(board_m)) {
           break;
         }
+      } else {
+        frames_m.emplace_back();
+        frame_type& frame = frames_m.back();
+        frame.next = 0;
+        frame.last = Branching::select(board_m, frame.alternatives) - frame.alternatives;
+        frame.mark = trail_m.size();
+        this->stats_m.depth(frames_m.size());
+        if (frame.last == frame.next) {
+          // Some cell or value has nowhere to go.
+          this->stats_m.contradiction();
+        }
       }
     }
+    while (! frames_m.empty() && frames_m.back().next == frames_m.back().last) {
+      frames_m.pop_back();
+    }
+    if (frames_m.empty()) {
+      break;
+    }
+    frame_type& frame = frames_m.back();
+    trail_m.undo(board_m, frame.mark);
+    const std::pair<int, int>& alternative = frame.alternatives[frame.next++];
+    consistent = propagate(board_m, alternative.first, alternative.second, trail_m);
   }
 }
+
+// Takes the last pending alternative of the shallowest node out of
+// the ongoing search, and writes the board it leads to into board
+// instead, so that it can be searched elsewhere. Returns false if
+// there was no consistent alternative to take.
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+bool com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::split(sudoku_board<Layout>& board) {
+  bool result = false;
+  for (auto it = frames_m.begin(); ! result && it != frames_m.end(); ++it) {
+    while (! result && it->next != it->last) {
+      const std::pair<int, int>& alternative = it->alternatives[--it->last];
+      board = board_m;
+      trail_m.rewind(board, it->mark);
+      result = propagate(board, alternative.first, alternative.second, no_trail());
+    }
+  }
+  return result;
+}
+
+// Places value at pos, and propagates the consequences with the
+// trivial solver and the Propagation policy.
+template<typename Layout, typename Branching, typename Propagation, typename Stats>
+template<typename Trail>
+inline bool com_masaers::depth_first_solver<Layout, Branching, Propagation, Stats>::propagate(sudoku_board<Layout>& board, const int pos, const int value, Trail&& trail) {
+  return this->apply_mask(board, pos, sudoku_board<Layout>::make_mask(value), trail)
+  &&     propagation_m(board, trail);
+}
+
+#endif
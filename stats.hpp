@@ -0,0 +1,123 @@
+#ifndef COM_MASAERS_STATS_HPP
+#define COM_MASAERS_STATS_HPP
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+namespace com_masaers {
+  // Statistics policies are told by the solvers what they do: nodes
+  // entered, cells put on the agenda, masks applied, contradictions
+  // found and how deep the search went. Every call to a solver starts
+  // its statistics afresh, so they describe one puzzle at a time.
+
+  /**
+     Keeps no statistics. Every hook is an empty inline function, so a
+     solver compiled with it is the same as one without hooks.
+   */
+  class no_stats {
+  public:
+    void clear() {}
+    void node() {}
+    void agenda_pushes(const std::size_t) {}
+    void apply_masks(const std::size_t) {}
+    void contradiction() {}
+    void depth(const std::size_t) {}
+    no_stats& operator+=(const no_stats&) { return *this; }
+    void maximize(const no_stats&) {}
+    void append_json(std::string& out) const { out += "{}"; }
+  }; // no_stats
+
+  /**
+     Counts everything that the solvers report.
+   */
+  class search_stats {
+  public:
+    void clear() { *this = search_stats(); }
+    void node() { ++nodes_m; }
+    void agenda_pushes(const std::size_t n) { agenda_pushes_m += n; }
+    void apply_masks(const std::size_t n) { apply_masks_m += n; }
+    void contradiction() { ++contradictions_m; }
+    void depth(const std::size_t d) { max_depth_m = std::max(max_depth_m, d); }
+    std::size_t nodes() const { return nodes_m; }
+    std::size_t agenda_pushes() const { return agenda_pushes_m; }
+    std::size_t apply_masks() const { return apply_masks_m; }
+    std::size_t contradictions() const { return contradictions_m; }
+    std::size_t max_depth() const { return max_depth_m; }
+    // Adds up the counters, and keeps the deeper of the depths.
+    search_stats& operator+=(const search_stats& x);
+    // Keeps the larger of every counter.
+    void maximize(const search_stats& x);
+    void append_json(std::string& out) const;
+  private:
+    std::size_t nodes_m = 0;
+    std::size_t agenda_pushes_m = 0;
+    std::size_t apply_masks_m = 0;
+    std::size_t contradictions_m = 0;
+    std::size_t max_depth_m = 0;
+  }; // search_stats
+
+  /**
+     The statistics of a run of many puzzles: their totals, and the
+     largest value of every counter seen in any one puzzle, which is
+     where latency spikes show up.
+   */
+  template<typename Stats>
+  class run_stats {
+  public:
+    void add(const Stats& puzzle) { ++puzzles_m; total_m += puzzle; max_m.maximize(puzzle); }
+    run_stats& operator+=(const run_stats& x) { puzzles_m += x.puzzles_m; total_m += x.total_m; max_m.maximize(x.max_m); return *this; }
+    std::size_t puzzles() const { return puzzles_m; }
+    const Stats& total() const { return total_m; }
+    const Stats& max() const { return max_m; }
+    void append_json(std::string& out) const;
+  private:
+    std::size_t puzzles_m = 0;
+    Stats total_m;
+    Stats max_m;
+  }; // run_stats
+} // namespace com_masaers
+
+
+inline com_masaers::search_stats& com_masaers::search_stats::operator+=(const search_stats& x) {
+  nodes_m += x.nodes_m;
+  agenda_pushes_m += x.agenda_pushes_m;
+  apply_masks_m += x.apply_masks_m;
+  contradictions_m += x.contradictions_m;
+  max_depth_m = std::max(max_depth_m, x.max_depth_m);
+  return *this;
+}
+
+inline void com_masaers::search_stats::maximize(const search_stats& x) {
+  nodes_m = std::max(nodes_m, x.nodes_m);
+  agenda_pushes_m = std::max(agenda_pushes_m, x.agenda_pushes_m);
+  apply_masks_m = std::max(apply_masks_m, x.apply_masks_m);
+  contradictions_m = std::max(contradictions_m, x.contradictions_m);
+  max_depth_m = std::max(max_depth_m, x.max_depth_m);
+}
+
+inline void com_masaers::search_stats::append_json(std::string& out) const {
+  out += "{\"nodes\":";
+  out += std::to_string(nodes_m);
+  out += ",\"agenda_pushes\":";
+  out += std::to_string(agenda_pushes_m);
+  out += ",\"apply_masks\":";
+  out += std::to_string(apply_masks_m);
+  out += ",\"contradictions\":";
+  out += std::to_string(contradictions_m);
+  out += ",\"max_depth\":";
+  out += std::to_string(max_depth_m);
+  out += '}';
+}
+
+template<typename Stats>
+void com_masaers::run_stats<Stats>::append_json(std::string& out) const {
+  out += "{\"puzzles\":";
+  out += std::to_string(puzzles_m);
+  out += ",\"total\":";
+  total_m.append_json(out);
+  out += ",\"max\":";
+  max_m.append_json(out);
+  out += '}';
+}
+
+#endif
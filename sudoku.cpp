@@ -1,51 +1,249 @@
 #include "sudoku.hpp"
 #include "pseudoku.hpp"
 #include "solver.hpp"
+#include "parallel_solver.hpp"
+#include "bitboard.hpp"
+#include "dlx.hpp"
+#include "backjump.hpp"
+#include "batch.hpp"
 #include "timer.hpp"
+#include "stats.hpp"
+#include "input.hpp"
+#include "output.hpp"
+#include "registry.hpp"
+#include "server.hpp"
 #include <iostream>
-#include <fstream>
 #include <functional>
+#include <memory>
 #include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
-template<typename Layout>
-bool process_board(com_masaers::sudoku_board<Layout>& board, com_masaers::timer& solve_time, const std::size_t max_solutions) {
+template<typename Layout, typename Search>
+bool process_board(com_masaers::sudoku_board<Layout>& board, com_masaers::timer& solve_time, const std::size_t max_solutions, Search& depth_first, com_masaers::puzzle_writer& out) {
   using namespace std;
   using namespace com_masaers;
   static trivial_solver<Layout> trivial;
-  static depth_first_solver<Layout> depth_first;
   bool result = false;
   timer local_time;
   if (board.valid()) {
-    cout << board << endl;
+    out.echo(board);
     local_time.start();
     board = trivial(board);
     local_time.stop();
     if (board.valid() && board.solved()) {
-      cout << board << endl;
-      cout << "Found trivial solution!" << endl;
+      out.write(board);
+      out << "Found trivial solution!\n";
       result = true;
     } else {
-      cout << "Looking for at most " << max_solutions << " solution(s)..." << endl;
+      out << "Looking for at most " << max_solutions << " solution(s)...\n";
       local_time.start();
       auto boards = depth_first(board, max_solutions);
       local_time.stop();
       if (boards.empty()) {
-        cout << "Failed to find solution." << endl;
+        out << "Failed to find solution.\n";
       } else {
-        cout << boards.front() << endl;
-        cout << "Found " << boards.size() << " solution(s)!" << endl;
+        out.write(boards.front());
+        out << "Found " << boards.size() << " solution(s)!\n";
         result = true;
       }
     }
   } else {
-    cout << "Provided board not valid." << endl;
+    out << "Provided board not valid.\n";
   }
-  cout << "Time spent solving this problem: " << local_time << "." << endl;
+  out << "Time spent solving this problem: " << local_time << ".\n";
   solve_time += local_time;
   return result;
 }
 
 
+// The search engines of batch mode, for any layout. The bitboard
+// engine only exists for 9x9 boards, and other sizes fall back to
+// depth first search.
+template<template<typename> class Propagation, typename Stats = com_masaers::no_stats>
+struct depth_first_engine {
+  template<typename Layout> using type = com_masaers::depth_first_solver<Layout, com_masaers::hidden_candidate_branching, Propagation<Layout>, Stats>;
+};
+template<typename Layout>
+using bitboard_engine = typename std::conditional<std::is_same<Layout, com_masaers::sudoku_layout<3> >::value, com_masaers::bitboard_solver, com_masaers::depth_first_solver<Layout> >::type;
+template<typename Layout>
+using dlx_engine = com_masaers::dlx_solver<Layout>;
+template<typename Layout>
+using backjump_engine = com_masaers::backjumping_solver<Layout>;
+
+
+// Serves puzzles over the Unix domain socket at path, or over stdin
+// and stdout if path is empty, until stdin ends or the server is
+// interrupted, and then reports how many were answered on stderr.
+template<template<typename> class SearchOf>
+bool process_serve(const char* path, const std::size_t threads, com_masaers::solution_cache* cache) {
+  using namespace std;
+  using namespace com_masaers;
+  puzzle_server<supported_layouts, SearchOf> server(threads, cache);
+  signal(SIGINT, stop_serving);
+  signal(SIGTERM, stop_serving);
+  signal(SIGPIPE, SIG_IGN);
+  const bool result = *path == '\0' ? server.serve_stdio() : server.serve_socket(path);
+  if (! result) {
+    cerr << server.error() << endl;
+  }
+  cerr << "Answered " << server.requests() << " request(s) in " << server.batches() << " batch(es)." << endl;
+  if (cache != nullptr) {
+    cerr << "Cache: " << cache->hits() << " hit(s) and " << cache->misses() << " miss(es) over " << cache->capacity() << " entries." << endl;
+  }
+  server.phases().print_to(cerr);
+  return result;
+}
+
+
+// Solves every puzzle in the one-line-per-puzzle files (or stdin),
+// whatever their sizes, and reports the total throughput and the
+// latencies of every phase on stderr, followed by the statistics of
+// the run in JSON unless Stats is no_stats. With a cache size, 9x9
+// puzzles are looked up by their canonical forms in a cache of that
+// many solutions before they are solved. With a path to serve, the
+// puzzles come from clients instead (see process_serve).
+template<template<typename> class SearchOf, typename Stats = com_masaers::no_stats>
+bool process_batch(const std::vector<const char*>& files, const bool print_status, const std::size_t threads, const std::size_t cache_size, const char* serve) {
+  using namespace std;
+  using namespace com_masaers;
+  bool result = true;
+  size_t puzzles = 0;
+  timer batch_time;
+  ios::sync_with_stdio(false);
+  batch_time.start();
+  unique_ptr<solution_cache> cache;
+  if (cache_size > 0) {
+    cache.reset(new solution_cache(cache_size));
+  }
+  if constexpr (is_same<Stats, no_stats>::value) {
+    if (serve != nullptr) {
+      return process_serve<SearchOf>(serve, threads, cache.get());
+    }
+  }
+  mixed_batch_solver<supported_layouts, SearchOf, Stats> solve(threads, cache.get());
+  if (files.empty()) {
+    puzzle_reader in;
+    result = solve(in, cout, print_status, puzzles);
+  } else {
+    for (auto it = files.begin(); it != files.end(); ++it) {
+      puzzle_reader in(*it);
+      if (! in.good()) {
+        cerr << in.error() << endl;
+        result = false;
+      } else {
+        result = solve(in, cout, print_status, puzzles) && result;
+      }
+    }
+  }
+  batch_time.stop();
+  const double seconds = batch_time.ns() / 1e9;
+  cerr << "Solved " << puzzles << " puzzle(s) in " << batch_time << " s";
+  if (seconds > 0) {
+    cerr << " (" << static_cast<uint64_t>(puzzles / seconds) << " puzzles/s)";
+  }
+  cerr << "." << endl;
+  if (cache) {
+    cerr << "Cache: " << cache->hits() << " hit(s) and " << cache->misses() << " miss(es) over " << cache->capacity() << " entries." << endl;
+  }
+  solve.phases().print_to(cerr);
+  if (! is_same<Stats, no_stats>::value) {
+    string json;
+    solve.stats().append_json(json);
+    cerr << json << endl;
+  }
+  return result;
+}
+
+
+// Batch mode for the depth first engine, which can keep statistics.
+template<template<typename> class Propagation>
+bool process_depth_first_batch(const std::vector<const char*>& files, const bool print_status, const std::size_t threads, const std::size_t cache_size, const char* serve, const bool print_stats) {
+  using namespace com_masaers;
+  if (print_stats) {
+    return process_batch<depth_first_engine<Propagation, search_stats>::template type, search_stats>(files, print_status, threads, cache_size, serve);
+  }
+  return process_batch<depth_first_engine<Propagation>::template type>(files, print_status, threads, cache_size, serve);
+}
+
+
+// Solves one board with the search engine picked on the command line.
+template<typename Layout, typename Propagation>
+bool solve_board(com_masaers::sudoku_board<Layout>& board, const std::string& engine, const std::size_t threads, const std::size_t max_solutions, com_masaers::timer& solve_time, com_masaers::puzzle_writer& out) {
+  using namespace com_masaers;
+  if (engine == "bitboard") {
+    bitboard_engine<Layout> bitboard;
+    return process_board(board, solve_time, max_solutions, bitboard, out);
+  } else if (engine == "dlx") {
+    dlx_solver<Layout> dlx;
+    return process_board(board, solve_time, max_solutions, dlx, out);
+  } else if (engine == "backjump") {
+    backjumping_solver<Layout> backjump;
+    return process_board(board, solve_time, max_solutions, backjump, out);
+  } else if (threads > 1) {
+    parallel_depth_first_solver<Layout, hidden_candidate_branching, Propagation> parallel(threads);
+    return process_board(board, solve_time, max_solutions, parallel, out);
+  }
+  depth_first_solver<Layout, hidden_candidate_branching, Propagation> serial;
+  return process_board(board, solve_time, max_solutions, serial, out);
+}
+
+
+// Solves the boards in the grid format files (or stdin) one at a time,
+// with the search engine picked on the command line. The size of every
+// board is told by the number of values on its first row.
+template<template<typename> class Propagation>
+bool process_boards(const std::vector<const char*>& files, const std::string& engine, const std::size_t threads, const std::size_t max_solutions, com_masaers::timer& solve_time, com_masaers::puzzle_writer& out) {
+  using namespace std;
+  using namespace com_masaers;
+  bool result = true;
+  // Reads the board of one input, and solves it. Whatever follows the
+  // board, such as the notes on where it came from in the data/
+  // files, is ignored.
+  auto process_first = [&](puzzle_reader& in) {
+    const int size = in.good() ? in.next_grid_size() : 0;
+    const int layout = supported_layouts::index_of_size(size);
+    bool read = false;
+    if (in.good() && layout != supported_layouts::SIZE) {
+      supported_layouts::visit(layout, [&](auto tag) {
+          typedef typename decltype(tag)::type layout_type;
+          sudoku_board<layout_type> board;
+          read = in.next_grid(board) == puzzle_reader::read;
+          if (read) {
+            result = solve_board<layout_type, Propagation<layout_type> >(board, engine, threads, max_solutions, solve_time, out) && result;
+          }
+        });
+    }
+    if (! read) {
+      if (! in.good()) {
+        cerr << in.error() << endl;
+      } else if (size == 0) {
+        cerr << in.name() << ": no board." << endl;
+      } else {
+        cerr << in.name() << ": a first row of " << size << " values is no row of a " << supported_layouts::names() << " board." << endl;
+      }
+      result = false;
+    }
+  };
+  if (! files.empty()) {
+    for (auto it = files.begin(); result && it != files.end(); ++it) {
+      puzzle_reader in(*it);
+      out << "file: " << *it << '\n';
+      process_first(in);
+    }
+  } else {
+    puzzle_reader in;
+    process_first(in);
+  }
+  return result;
+}
+
+
 int main(const int argc, const char** argv) {
   using namespace std;
   using namespace com_masaers;
@@ -55,24 +253,113 @@ int main(const int argc, const char** argv) {
   program_time.start();
   bool exit_status = true;
   std::size_t max_solutions = 1;
+  bool batch = false;
+  bool print_status = false;
+  bool print_stats = false;
+  bool quiet = false;
+  puzzle_writer::format_type format = puzzle_writer::pencilmarks;
+  bool format_given = false;
+  std::size_t threads = 1;
+  std::size_t cache_size = 0;
+  const char* serve = nullptr;
+  string engine = "depth_first";
+  string propagation = "naked";
+  vector<const char*> files;
 
-  sudoku_board<> board;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--batch") == 0) {
+      batch = true;
+    } else if (strcmp(argv[i], "--status") == 0) {
+      print_status = true;
+    } else if (strcmp(argv[i], "--stats=json") == 0) {
+      print_stats = true;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else if (strncmp(argv[i], "--format=", 9) == 0) {
+      if (! puzzle_writer::parse_format(argv[i] + 9, format)) {
+        cerr << "Unknown format: " << argv[i] + 9 << "." << endl;
+        return EXIT_FAILURE;
+      }
+      format_given = true;
+    } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+      threads = strtoul(argv[i] + 10, nullptr, 10);
+      if (threads == 0) {
+        threads = thread::hardware_concurrency();
+      }
+    } else if (strcmp(argv[i], "--serve") == 0) {
+      serve = "";
+    } else if (strncmp(argv[i], "--serve=", 8) == 0) {
+      serve = argv[i] + 8;
+    } else if (strncmp(argv[i], "--cache=", 8) == 0) {
+      cache_size = strtoul(argv[i] + 8, nullptr, 10);
+    } else if (strncmp(argv[i], "--engine=", 9) == 0) {
+      engine = argv[i] + 9;
+      if (engine != "depth_first" && engine != "bitboard" && engine != "dlx" && engine != "backjump") {
+        cerr << "Unknown engine: " << engine << "." << endl;
+        return EXIT_FAILURE;
+      }
+    } else if (strncmp(argv[i], "--propagation=", 14) == 0) {
+      propagation = argv[i] + 14;
+      if (propagation != "naked" && propagation != "hidden" && propagation != "full") {
+        cerr << "Unknown propagation: " << propagation << "." << endl;
+        return EXIT_FAILURE;
+      }
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
 
-  if (argc > 1) {
-    for (int i = 1; i < argc; ++i) {
-      std::ifstream file(argv[i]);
-      board.read(file);
-      cout << "file: " << argv[i] << endl;
-      exit_status = exit_status && process_board(board, solve_time, max_solutions);
+  if (serve != nullptr) {
+    if (! files.empty() || print_stats) {
+      cerr << "--serve takes neither files nor --stats=json." << endl;
+      return EXIT_FAILURE;
     }
+    batch = true;
+  }
+  if (print_stats && ! (batch && engine == "depth_first")) {
+    cerr << "--stats=json needs --batch and the depth_first engine." << endl;
+    return EXIT_FAILURE;
+  }
+  if (cache_size > 0 && ! batch) {
+    cerr << "--cache needs --batch." << endl;
+    return EXIT_FAILURE;
+  }
+  if (batch && format_given && format != puzzle_writer::compact) {
+    cerr << "Batch mode only writes the compact format." << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (batch) {
+    if (engine == "bitboard") {
+      exit_status = process_batch<bitboard_engine>(files, print_status, threads, cache_size, serve);
+    } else if (engine == "dlx") {
+      exit_status = process_batch<dlx_engine>(files, print_status, threads, cache_size, serve);
+    } else if (engine == "backjump") {
+      exit_status = process_batch<backjump_engine>(files, print_status, threads, cache_size, serve);
+    } else if (propagation == "hidden") {
+      exit_status = process_depth_first_batch<hidden_single_propagation>(files, print_status, threads, cache_size, serve, print_stats);
+    } else if (propagation == "full") {
+      exit_status = process_depth_first_batch<pseudoku_propagation>(files, print_status, threads, cache_size, serve, print_stats);
+    } else {
+      exit_status = process_depth_first_batch<naked_single_propagation>(files, print_status, threads, cache_size, serve, print_stats);
+    }
+    return exit_status ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  ios::sync_with_stdio(false);
+  puzzle_writer out(cout, format, quiet);
+  if (propagation == "hidden") {
+    exit_status = process_boards<hidden_single_propagation>(files, engine, threads, max_solutions, solve_time, out);
+  } else if (propagation == "full") {
+    exit_status = process_boards<pseudoku_propagation>(files, engine, threads, max_solutions, solve_time, out);
   } else {
-    board.read(cin);
-    exit_status = exit_status && process_board(board, solve_time, max_solutions);
+    exit_status = process_boards<naked_single_propagation>(files, engine, threads, max_solutions, solve_time, out);
   }
 
-  cout << "Time spent solving: " << solve_time << "." << endl;    
+  out << "Time spent solving: " << solve_time << ".\n";
   program_time.stop();
-  cout << "Total runtime: " << program_time << endl;
+  out << "Total runtime: " << program_time << '\n';
+  out.flush();
 
   return exit_status ? EXIT_SUCCESS : EXIT_FAILURE;
 }
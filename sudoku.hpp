@@ -1,7 +1,12 @@
 #ifndef COM_MASAERS_SUDOKU_HPP
 #define COM_MASAERS_SUDOKU_HPP
-#include <bitset>
+#include "cell.hpp"
+#include <array>
 #include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace com_masaers {
   // Example:
@@ -59,7 +64,13 @@ namespace com_masaers {
     static constexpr int NN = N * N;
     static constexpr int HOUSES_PER_ROW = HROWS;
     static constexpr int HOUSES_PER_COL = HCOLS;
-    typedef std::bitset<N> cell_type;
+    // The number of units (rows, columns and houses).
+    static constexpr int UNITS = 3 * N;
+    // The number of distinct cells sharing a unit with any one cell.
+    static constexpr int PEERS = 2 * (N - 1) + (HROWS - 1) * (HCOLS - 1);
+    typedef sudoku_cell<N> cell_type;
+    // A set of absolute positions.
+    typedef sudoku_cell<NN> position_set;
     /// Gets the absolute position of the Cth column from the Rth row.
     static constexpr int pos_of_rowcol(const int row, const int col) {
       return (row * N) + col;
@@ -120,12 +131,84 @@ namespace com_masaers {
     static constexpr const int* last_house_dep(const int pos) {
       return last_dep(pos);
     }
+    // Returns an iterator to the first peer of an absolute position.
+    // The peers are the dependents without repetition: the row, then
+    // the column, then the rest of the house.
+    static constexpr const int* first_peer(const int pos) {
+      return &peers_m[pos][0];
+    }
+    // Returns an iterator to the last peer of an absolute position.
+    static constexpr const int* last_peer(const int pos) {
+      return &peers_m[pos][PEERS];
+    }
+    // Gets the absolute position of the Ith cell of the Uth unit. Units
+    // are numbered rows first, then columns, then houses.
+    static constexpr int pos_of_unit(const int unit, const int i) {
+      return units_m[unit][i];
+    }
+    // Gets the set of peers of an absolute position.
+    static constexpr const position_set& peer_mask(const int pos) {
+      return peer_masks_m[pos];
+    }
+    // Gets the set of positions in the Uth unit.
+    static constexpr const position_set& unit_mask(const int unit) {
+      return unit_masks_m[unit];
+    }
   protected:
-    static std::array<std::array<int, 3*(N-1)>, NN> create_dependents();
-    static const std::array<std::array<int, 3*(N-1)>, NN> dependents_m;
+    typedef std::array<std::array<int, 3*(N-1)>, NN> dependents_type;
+    typedef std::array<std::array<int, PEERS>, NN> peers_type;
+    typedef std::array<std::array<int, N>, UNITS> units_type;
+    typedef std::array<position_set, NN> peer_masks_type;
+    typedef std::array<position_set, UNITS> unit_masks_type;
+    static constexpr dependents_type create_dependents();
+    static constexpr peers_type create_peers();
+    static constexpr units_type create_units();
+    static constexpr peer_masks_type create_peer_masks();
+    static constexpr unit_masks_type create_unit_masks();
+    // All tables are constant initialized, so no layout costs anything
+    // at startup.
+    static const dependents_type dependents_m;
+    static const peers_type peers_m;
+    static const units_type units_m;
+    static const peer_masks_type peer_masks_m;
+    static const unit_masks_type unit_masks_m;
   }; // sudoku_layout
 
 
+  /**
+     The characters that stand for the N values of a cell in the
+     compact one-line format: '1'-'9', then 'A'-'Z', then 'a'-'z', which
+     is enough for up to 61 values. On boards of up to 35 values, lower
+     case letters are read as the upper case ones. Blanks are '.' or
+     '0'.
+   */
+  template<int N>
+  class sudoku_symbols {
+  public:
+    static_assert(N <= 61, "the compact format has no symbols for more than 61 values");
+    // What value_of returns for a blank.
+    static constexpr int BLANK = N;
+    // The character of a value, counted from 0.
+    static constexpr char symbol_of(const int value) {
+      return value < 9 ? char('1' + value) : value < 35 ? char('A' + value - 9) : char('a' + value - 35);
+    }
+    // The value of a character, BLANK for a blank or -1 if it is
+    // neither.
+    static int value_of(const char c) { return values_m[static_cast<unsigned char>(c)]; }
+    // The cell that a character stands for: a single value, every
+    // value for a blank, or no value if it is neither. Reading cells
+    // from this table takes no branches on the characters.
+    static const sudoku_cell<N>& cell_of(const char c) { return cells_m[static_cast<unsigned char>(c)]; }
+  protected:
+    typedef std::array<signed char, 256> values_type;
+    typedef std::array<sudoku_cell<N>, 256> cells_type;
+    static constexpr values_type create_values();
+    static constexpr cells_type create_cells();
+    static constexpr values_type values_m = create_values();
+    static constexpr cells_type cells_m = create_cells();
+  }; // sudoku_symbols
+
+
   /**
      Represents an instance of a sudoku board.
    */
@@ -138,35 +221,89 @@ namespace com_masaers {
     int unknown_m;
   public:
     static cell_type make_mask(int value);
+    void clear();
     bool operator==(const sudoku_board& x) const;
     bool operator!=(const sudoku_board& x) const;
     template<typename OutputIter> void read(std::istream& is, OutputIter&& out);
     void read(std::istream& is);
+    bool read_line(const char* first, const char* last);
+    bool read_grid(const char*& first, const char* last);
     void print_to(std::ostream& os) const; 
+    template<typename OutputIter> OutputIter write_line(OutputIter out) const;
+    template<typename OutputIter> OutputIter write_grid(OutputIter out) const;
+    template<typename OutputIter> OutputIter write_pencilmarks(OutputIter out) const;
     const cell_type get_known_buddies(const int pos);
     template<typename OutputIter> bool apply_mask(const int pos, cell_type mask, OutputIter&& out);
+    template<typename OutputIter, typename Trail> bool apply_mask(const int pos, cell_type mask, OutputIter&& out, Trail&& trail);
     template<typename OutputIter> void try_mask(const int pos, const cell_type& mask, OutputIter&& out);
+    template<typename OutputIter, typename Trail> void try_mask(const int pos, const cell_type& mask, OutputIter&& out, Trail&& trail);
+    void restore(const int pos, const cell_type& cell);
     bool solved() const;
     bool solved(const cell_type& cell) const;
     bool solved(const int pos) const;
     const int unknown() const;
     template<typename OutputIter> bool propagate_solution(const int pos, OutputIter&& out);
+    template<typename OutputIter, typename Trail> bool propagate_solution(const int pos, OutputIter&& out, Trail&& trail);
     cell_type& operator[](const int pos);
     const cell_type& operator[](const int pos) const;
     bool valid() const;
     friend std::ostream& operator<<(std::ostream& os, const sudoku_board& board) { board.print_to(os); return os; }
   }; // sudoku_board
+
+
+  /**
+     Records the previous contents of every cell that a board changes,
+     so that the board can be restored to an earlier state without
+     keeping a copy of it. Pass it to the board methods that take a
+     trail.
+   */
+  template<typename Layout = sudoku_layout<3> >
+  class sudoku_trail {
+  public:
+    typedef typename Layout::cell_type cell_type;
+    std::size_t size() const { return entries_m.size(); }
+    void clear() { entries_m.clear(); }
+    void reserve(const std::size_t size) { entries_m.reserve(size); }
+    void record(const int pos, const cell_type& cell) { entries_m.emplace_back(pos, cell); }
+    void undo(sudoku_board<Layout>& board, const std::size_t mark);
+    void rewind(sudoku_board<Layout>& board, const std::size_t mark) const;
+  private:
+    std::vector<std::pair<int, cell_type> > entries_m;
+  }; // sudoku_trail
+
+  /**
+     A trail that records nothing.
+   */
+  struct no_trail {
+    template<typename Cell> void record(const int, const Cell&) {}
+  }; // no_trail
 } // namespace com_masaers
 
 
 template<int HROWS, int HCOLS>
-const std::array<std::array<int, 3*(com_masaers::sudoku_layout<HROWS, HCOLS>::N-1)>, com_masaers::sudoku_layout<HROWS, HCOLS>::NN>
-com_masaers::sudoku_layout<HROWS, HCOLS>::dependents_m = com_masaers::sudoku_layout<HROWS, HCOLS>::create_dependents();
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::dependents_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::dependents_m = create_dependents();
+
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::peers_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::peers_m = create_peers();
+
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::units_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::units_m = create_units();
+
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::peer_masks_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::peer_masks_m = create_peer_masks();
+
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::unit_masks_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::unit_masks_m = create_unit_masks();
 
 template<int HROWS, int HCOLS>
-std::array<std::array<int, 3*(com_masaers::sudoku_layout<HROWS, HCOLS>::N-1)>, com_masaers::sudoku_layout<HROWS, HCOLS>::NN>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::dependents_type
 com_masaers::sudoku_layout<HROWS, HCOLS>::create_dependents() {
-  std::array<std::array<int, 3*(N-1)>, NN> result;
+  dependents_type result{};
   for (int pos = 0; pos < NN; ++pos) {
     int dep = 0;
     for (int col = 0; col < N; ++col) {
@@ -188,6 +325,81 @@ com_masaers::sudoku_layout<HROWS, HCOLS>::create_dependents() {
   return result;
 }
 
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::peers_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::create_peers() {
+  peers_type result{};
+  for (int pos = 0; pos < NN; ++pos) {
+    int peer = 0;
+    for (int col = 0; col < N; ++col) {
+      if (col != col_of_pos(pos)) {
+        result[pos][peer++] = pos_of_rowcol(row_of_pos(pos), col);
+      }
+    }
+    for (int row = 0; row < N; ++row) {
+      if (row != row_of_pos(pos)) {
+        result[pos][peer++] = pos_of_rowcol(row, col_of_pos(pos));
+      }
+    }
+    for (int room = 0; room < N; ++room) {
+      const int other = pos_of_houseroom(house_of_pos(pos), room);
+      if (row_of_pos(other) != row_of_pos(pos) && col_of_pos(other) != col_of_pos(pos)) {
+        result[pos][peer++] = other;
+      }
+    }
+  }
+  return result;
+}
+
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::units_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::create_units() {
+  units_type result{};
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      result[i][j] = pos_of_rowcol(i, j);
+      result[N + i][j] = pos_of_rowcol(j, i);
+      result[2 * N + i][j] = pos_of_houseroom(i, j);
+    }
+  }
+  return result;
+}
+
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::peer_masks_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::create_peer_masks() {
+  peer_masks_type result{};
+  const peers_type peers = create_peers();
+  for (int pos = 0; pos < NN; ++pos) {
+    for (int peer = 0; peer < PEERS; ++peer) {
+      result[pos].set(peers[pos][peer]);
+    }
+  }
+  return result;
+}
+
+template<int HROWS, int HCOLS>
+constexpr typename com_masaers::sudoku_layout<HROWS, HCOLS>::unit_masks_type
+com_masaers::sudoku_layout<HROWS, HCOLS>::create_unit_masks() {
+  unit_masks_type result{};
+  const units_type units = create_units();
+  for (int unit = 0; unit < UNITS; ++unit) {
+    for (int i = 0; i < N; ++i) {
+      result[unit].set(units[unit][i]);
+    }
+  }
+  return result;
+}
+
+// Makes every cell of the board unknown.
+template<typename Layout>
+inline void com_masaers::sudoku_board<Layout>::clear() {
+  for (int pos = 0; pos < Layout::NN; ++pos) {
+    cells_m[pos].set();
+  }
+  unknown_m = Layout::NN;
+}
+
 template<typename Layout>
 inline bool com_masaers::sudoku_board<Layout>::operator==(const sudoku_board& x) const {
   bool result = unknown_m == x.unknown_m;
@@ -241,28 +453,185 @@ void com_masaers::sudoku_board<Layout>::read(std::istream& is) {
   }
 }
 
+template<int N>
+constexpr typename com_masaers::sudoku_symbols<N>::values_type com_masaers::sudoku_symbols<N>::create_values() {
+  values_type result{};
+  for (int c = 0; c < 256; ++c) {
+    result[c] = -1;
+  }
+  result['.'] = result['0'] = BLANK;
+  for (int value = 0; value < N; ++value) {
+    const char c = symbol_of(value);
+    result[static_cast<unsigned char>(c)] = value;
+    if (N <= 35 && c >= 'A' && c <= 'Z') {
+      result[static_cast<unsigned char>(c - 'A' + 'a')] = value;
+    }
+  }
+  return result;
+}
+
+template<int N>
+constexpr typename com_masaers::sudoku_symbols<N>::cells_type com_masaers::sudoku_symbols<N>::create_cells() {
+  cells_type result{};
+  for (int c = 0; c < 256; ++c) {
+    if (values_m[c] == BLANK) {
+      result[c] = ~sudoku_cell<N>();
+    } else if (values_m[c] >= 0) {
+      result[c].set(values_m[c]);
+    }
+  }
+  return result;
+}
+
+// Reads a board from the compact one-line format, where each cell is
+// a single character (see sudoku_symbols): '1'-'9' for givens on a 9x9
+// board, and '.' or '0' for blanks. Returns false if [first, last) is
+// not exactly NN such characters.
 template<typename Layout>
-void com_masaers::sudoku_board<Layout>::print_to(std::ostream& os) const {
-  for (int i = 0; i < Layout::N; ++i) {
-    for (int j = 0; j < Layout::N; ++j) {
-      if (j != 0) { os << ' '; }
-      const auto& cell = (*this)[Layout::pos_of_rowcol(i, j)];
-      for (int k = 0; k < Layout::N; ++k) {
-        if (cell[k]) {
-          os << (k + 1);
-        } else {
-          os << '.';
+bool com_masaers::sudoku_board<Layout>::read_line(const char* first, const char* last) {
+  typedef sudoku_symbols<Layout::N> symbols;
+  bool result = (last - first) == Layout::NN;
+  int unknown = 0;
+  for (int pos = 0; result && pos < Layout::NN; ++pos) {
+    const char c = first[pos];
+    cells_m[pos] = symbols::cell_of(c);
+    unknown += symbols::value_of(c) == symbols::BLANK;
+    result = cells_m[pos].any();
+  }
+  unknown_m = unknown;
+  return result;
+}
+
+// Reads a board from the grid format of the data/ files: NN numbers
+// separated by whitespace, with 0 for blanks. Moves first past the
+// last number read. Returns false if there are not NN numbers between
+// 0 and N to read, with first at the character that is wrong (or at
+// last, if the input ends early).
+template<typename Layout>
+bool com_masaers::sudoku_board<Layout>::read_grid(const char*& first, const char* last) {
+  const cell_type all = ~cell_type();
+  bool result = true;
+  int unknown = 0;
+  for (int pos = 0; result && pos < Layout::NN; ++pos) {
+    while (first != last && (*first == ' ' || (*first >= '\t' && *first <= '\r'))) {
+      ++first;
+    }
+    const char* const start = first;
+    int number = 0;
+    while (first != last && *first >= '0' && *first <= '9' && number <= Layout::N) {
+      number = number * 10 + (*first - '0');
+      ++first;
+    }
+    if (number > Layout::N) {
+      // There is no value for the cell, so leave it alone.
+      first = start;
+      result = false;
+      break;
+    }
+    result = first != start && (first == last || *first == ' ' || (*first >= '\t' && *first <= '\r'));
+    if (number == 0) {
+      cells_m[pos] = all;
+      ++unknown;
+    } else {
+      cells_m[pos] = make_mask(number - 1);
+    }
+  }
+  unknown_m = unknown;
+  return result;
+}
+
+// Writes the board in the compact one-line format (see read_line);
+// cells that are not solved are written as '.'.
+template<typename Layout>
+template<typename OutputIter>
+OutputIter com_masaers::sudoku_board<Layout>::write_line(OutputIter out) const {
+  for (int pos = 0; pos < Layout::NN; ++pos) {
+    const cell_type& cell = (*this)[pos];
+    char c = '.';
+    if (solved(cell)) {
+      c = sudoku_symbols<Layout::N>::symbol_of(cell.first());
+    }
+    *out = c;
+    ++out;
+  }
+  return out;
+}
+
+// Writes the grid format read by read_grid: one row per line, with 0
+// for cells that are not solved, and an extra space between stacks.
+template<typename Layout>
+template<typename OutputIter>
+OutputIter com_masaers::sudoku_board<Layout>::write_grid(OutputIter out) const {
+  constexpr int STACK_COLS = Layout::N / Layout::HOUSES_PER_ROW;
+  constexpr int WIDTH = Layout::N < 10 ? 1 : Layout::N < 100 ? 2 : 3;
+  for (int row = 0; row < Layout::N; ++row) {
+    for (int col = 0; col < Layout::N; ++col) {
+      if (col != 0) {
+        *out = ' ';
+        ++out;
+        if (col % STACK_COLS == 0) {
+          *out = ' ';
+          ++out;
         }
       }
+      const cell_type& cell = (*this)[Layout::pos_of_rowcol(row, col)];
+      const int number = solved(cell) ? cell.first() + 1 : 0;
+      // Right aligned, so that the columns line up on large boards.
+      char digits[WIDTH];
+      int n = number;
+      for (int i = WIDTH - 1; i >= 0; --i) {
+        digits[i] = (i == WIDTH - 1 || n != 0) ? char('0' + n % 10) : ' ';
+        n /= 10;
+      }
+      for (int i = 0; i < WIDTH; ++i) {
+        *out = digits[i];
+        ++out;
+      }
     }
-    os << std::endl;
+    *out = '\n';
+    ++out;
   }
+  return out;
+}
+
+// Writes every candidate of every cell: one row per line, with N
+// characters per cell, the symbol of the value (see sudoku_symbols)
+// where it is a candidate and '.' where it is not.
+template<typename Layout>
+template<typename OutputIter>
+OutputIter com_masaers::sudoku_board<Layout>::write_pencilmarks(OutputIter out) const {
+  for (int row = 0; row < Layout::N; ++row) {
+    for (int col = 0; col < Layout::N; ++col) {
+      if (col != 0) {
+        *out = ' ';
+        ++out;
+      }
+      const cell_type& cell = (*this)[Layout::pos_of_rowcol(row, col)];
+      for (int k = 0; k < Layout::N; ++k) {
+        *out = cell[k] ? sudoku_symbols<Layout::N>::symbol_of(k) : '.';
+        ++out;
+      }
+    }
+    *out = '\n';
+    ++out;
+  }
+  return out;
+}
+
+// Writes the candidates of every cell (see write_pencilmarks) with a
+// single write, and without flushing the stream.
+template<typename Layout>
+void com_masaers::sudoku_board<Layout>::print_to(std::ostream& os) const {
+  std::string out;
+  out.reserve(Layout::NN * (Layout::N + 1) + Layout::N);
+  write_pencilmarks(std::back_inserter(out));
+  os.write(out.data(), out.size());
 }
 
 template<typename Layout>
 inline const typename Layout::cell_type com_masaers::sudoku_board<Layout>::get_known_buddies(const int pos) {
   cell_type result;
-  for (auto it = Layout::first_dep(pos); it != Layout::last_dep(pos); ++it) {
+  for (auto it = Layout::first_peer(pos); it != Layout::last_peer(pos); ++it) {
     result |= (*this)[*it];
   }
   return result;
@@ -271,24 +640,40 @@ inline const typename Layout::cell_type com_masaers::sudoku_board<Layout>::get_k
 template<typename Layout>
 template<typename OutputIter>
 inline bool com_masaers::sudoku_board<Layout>::apply_mask(const int pos, cell_type mask, OutputIter&& out) {
+  return apply_mask(pos, mask, out, no_trail());
+}
+
+template<typename Layout>
+template<typename OutputIter, typename Trail>
+inline bool com_masaers::sudoku_board<Layout>::apply_mask(const int pos, cell_type mask, OutputIter&& out, Trail&& trail) {
   cell_type& cell = (*this)[pos];
   mask &= cell;
-  if (mask != cell && mask.count() == 1) {
-    *out = pos;
-    ++out;
-    --unknown_m;
+  if (mask != cell) {
+    trail.record(pos, cell);
+    if (mask.single()) {
+      *out = pos;
+      ++out;
+      --unknown_m;
+    }
+    cell = mask;
   }
-  cell = mask;
   return ! cell.none();
 }
 
 template<typename Layout>
 template<typename OutputIter>
 inline void com_masaers::sudoku_board<Layout>::try_mask(const int pos, const cell_type& mask, OutputIter&& out) {
+  try_mask(pos, mask, out, no_trail());
+}
+
+template<typename Layout>
+template<typename OutputIter, typename Trail>
+inline void com_masaers::sudoku_board<Layout>::try_mask(const int pos, const cell_type& mask, OutputIter&& out, Trail&& trail) {
   cell_type& cell = (*this)[pos];
   if (! solved(cell)) {
     const cell_type new_cell = cell & mask;
     if (solved(new_cell)) {
+      trail.record(pos, cell);
       cell = new_cell;
       *out = pos;
       ++out;
@@ -297,6 +682,16 @@ inline void com_masaers::sudoku_board<Layout>::try_mask(const int pos, const cel
   }
 }
 
+// Puts back the earlier contents of a cell, as recorded by a trail.
+template<typename Layout>
+inline void com_masaers::sudoku_board<Layout>::restore(const int pos, const cell_type& cell) {
+  cell_type& current = (*this)[pos];
+  if (solved(current) && ! solved(cell)) {
+    ++unknown_m;
+  }
+  current = cell;
+}
+
 template<typename Layout>
 inline typename Layout::cell_type com_masaers::sudoku_board<Layout>::make_mask(int value) {
   cell_type result;
@@ -311,7 +706,7 @@ inline bool com_masaers::sudoku_board<Layout>::solved() const {
 
 template<typename Layout>
 inline bool com_masaers::sudoku_board<Layout>::solved(const cell_type& cell) const {
-  return cell.count() == 1;
+  return cell.single();
 }
 
 template<typename Layout>
@@ -327,11 +722,17 @@ inline const int com_masaers::sudoku_board<Layout>::unknown() const {
 template<typename Layout>
 template<typename OutputIter>
 inline bool com_masaers::sudoku_board<Layout>::propagate_solution(const int pos, OutputIter&& out) {
+  return propagate_solution(pos, out, no_trail());
+}
+
+template<typename Layout>
+template<typename OutputIter, typename Trail>
+inline bool com_masaers::sudoku_board<Layout>::propagate_solution(const int pos, OutputIter&& out, Trail&& trail) {
   using namespace std;
   bool result = true;
   cell_type mask = ~(*this)[pos];
-  for (auto it = Layout::first_dep(pos); result && it != Layout::last_dep(pos); ++it) {
-    result = result && apply_mask(*it, mask, out);
+  for (auto it = Layout::first_peer(pos); result && it != Layout::last_peer(pos); ++it) {
+    result = result && apply_mask(*it, mask, out, trail);
   }
   return result;
 }
@@ -353,7 +754,7 @@ bool com_masaers::sudoku_board<Layout>::valid() const {
     cell_type row, col, house;
     for (int j = 0; result && j < Layout::N; ++j) {
       const auto& row_cell = (*this)[Layout::pos_of_rowcol(i, j)];
-      if (row_cell.count() == 1) {
+      if (row_cell.single()) {
         if ((row & row_cell).any()) {
           result = false;
         } else {
@@ -361,7 +762,7 @@ bool com_masaers::sudoku_board<Layout>::valid() const {
         }
       }
       const auto& col_cell = (*this)[Layout::pos_of_rowcol(j, i)];
-      if (col_cell.count() == 1) {
+      if (col_cell.single()) {
         if ((col & col_cell).any()) {
           result = false;
         } else {
@@ -369,7 +770,7 @@ bool com_masaers::sudoku_board<Layout>::valid() const {
         }
       }
       const auto& room_cell = (*this)[Layout::pos_of_houseroom(i, j)];
-      if (room_cell.count() == 1) {
+      if (room_cell.single()) {
         if ((house & room_cell).any()) {
           result = false;
         } else {
@@ -381,4 +782,23 @@ bool com_masaers::sudoku_board<Layout>::valid() const {
   return result;
 }
 
+// Restores board to the state it had when the trail had mark entries,
+// and forgets the entries after the mark.
+template<typename Layout>
+inline void com_masaers::sudoku_trail<Layout>::undo(sudoku_board<Layout>& board, const std::size_t mark) {
+  while (entries_m.size() > mark) {
+    board.restore(entries_m.back().first, entries_m.back().second);
+    entries_m.pop_back();
+  }
+}
+
+// Restores board (typically a copy of the trailed board) to the state
+// it had when the trail had mark entries, keeping the trail intact.
+template<typename Layout>
+inline void com_masaers::sudoku_trail<Layout>::rewind(sudoku_board<Layout>& board, const std::size_t mark) const {
+  for (std::size_t i = entries_m.size(); i > mark; --i) {
+    board.restore(entries_m[i - 1].first, entries_m[i - 1].second);
+  }
+}
+
 #endif
@@ -1,11 +1,16 @@
 #ifndef COM_MASAERS_TIMER_HPP
 #define COM_MASAERS_TIMER_HPP
 #include <chrono>
+#include <cstdint>
 #include <iomanip>
 
 namespace com_masaers {
+	// The steady clock never jumps, so intervals measured with it are
+	// never negative or inflated by clock adjustments.
+	using steady_clock_type = std::chrono::steady_clock;
+
 	class timer {
-		using Clock = std::chrono::high_resolution_clock;
+		using Clock = steady_clock_type;
 		bool running_m;
 		Clock::time_point mark_m;
 		Clock::duration total_m;
@@ -74,6 +79,102 @@ namespace com_masaers {
 			return ostream;
 		}
 	}; // timer
+
+	/**
+	   Counts latencies (in nanoseconds) in logarithmic buckets, like an
+	   HDR histogram: values below 64 get a bucket each, and every power
+	   of two above that is split into 32 buckets, so any recorded value
+	   is known to within about 3%. Recording is a few instructions, and
+	   the whole histogram is a fixed array, so it can stay on all the
+	   time.
+	 */
+	class latency_histogram {
+		static constexpr int SUB_BITS = 5;
+		static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+		// Linear buckets below 2 * SUB_BUCKETS, then SUB_BUCKETS for each
+		// of the remaining powers of two.
+		static constexpr int BUCKETS = (65 - SUB_BITS) * SUB_BUCKETS;
+		uint64_t counts_m[BUCKETS];
+		uint64_t count_m;
+		uint64_t total_m;
+		uint64_t min_m;
+		uint64_t max_m;
+		static inline int bucket(const uint64_t ns) {
+			if (ns < 2 * SUB_BUCKETS) {
+				return static_cast<int>(ns);
+			}
+#if defined(__GNUC__)
+			const int shift = 63 - __builtin_clzll(ns) - SUB_BITS;
+#else
+			int shift = -SUB_BITS;
+			for (uint64_t x = ns; x > 1; x >>= 1) { ++shift; }
+#endif
+			return (shift + 1) * SUB_BUCKETS + static_cast<int>(ns >> shift) - SUB_BUCKETS;
+		}
+		// The largest value that falls in a bucket.
+		static inline uint64_t highest(const int bucket) {
+			if (bucket < 2 * SUB_BUCKETS) {
+				return bucket;
+			}
+			const int shift = bucket / SUB_BUCKETS - 1;
+			const uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+			return ((sub + 1) << shift) - 1;
+		}
+	public:
+		inline latency_histogram() : counts_m(), count_m(0), total_m(0), min_m(~uint64_t(0)), max_m(0) {}
+		inline void record(const uint64_t ns) {
+			++counts_m[bucket(ns)];
+			++count_m;
+			total_m += ns;
+			min_m = ns < min_m ? ns : min_m;
+			max_m = ns > max_m ? ns : max_m;
+		}
+		inline latency_histogram& operator+=(const latency_histogram& x) {
+			for (int i = 0; i < BUCKETS; ++i) {
+				counts_m[i] += x.counts_m[i];
+			}
+			count_m += x.count_m;
+			total_m += x.total_m;
+			min_m = x.min_m < min_m ? x.min_m : min_m;
+			max_m = x.max_m > max_m ? x.max_m : max_m;
+			return *this;
+		}
+		inline uint64_t count() const { return count_m; }
+		inline uint64_t total() const { return total_m; }
+		inline uint64_t min() const { return count_m == 0 ? 0 : min_m; }
+		inline uint64_t max() const { return max_m; }
+		// The latency that a fraction p (between 0 and 1) of the recorded
+		// latencies are at or below, rounded up to the end of its bucket.
+		inline uint64_t percentile(const double p) const {
+			uint64_t rank = static_cast<uint64_t>(p * count_m + 0.5);
+			rank = rank == 0 ? 1 : rank;
+			uint64_t seen = 0;
+			for (int i = 0; i < BUCKETS; ++i) {
+				seen += counts_m[i];
+				if (seen >= rank) {
+					const uint64_t result = highest(i);
+					return result < max_m ? result : max_m;
+				}
+			}
+			return max_m;
+		}
+	}; // latency_histogram
+
+	/**
+	   Records the time from its construction to its destruction in a
+	   histogram.
+	 */
+	class scoped_timer {
+		latency_histogram& histogram_m;
+		steady_clock_type::time_point start_m;
+	public:
+		inline explicit scoped_timer(latency_histogram& histogram) : histogram_m(histogram), start_m(steady_clock_type::now()) {}
+		scoped_timer(const scoped_timer&) = delete;
+		scoped_timer& operator=(const scoped_timer&) = delete;
+		inline ~scoped_timer() {
+			histogram_m.record(std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock_type::now() - start_m).count());
+		}
+	}; // scoped_timer
 } // namespace com_masaers
 
 #endif